@@ -0,0 +1,301 @@
+#include "BidirectionalBufferingSource.h"
+
+BidirectionalBufferingSource::BidirectionalBufferingSource (PositionableAudioSource* s,
+                                                            TimeSliceThread& thread,
+                                                            int samplesToBuffer,
+                                                            int channels)
+    : source (s),
+      backgroundThread (thread),
+      numberOfSamplesToBuffer (jmax (1024, samplesToBuffer)),
+      numberOfChannels (channels)
+{
+    jassert (source != nullptr);
+    jassert (numberOfChannels > 0);
+}
+
+BidirectionalBufferingSource::~BidirectionalBufferingSource()
+{
+    backgroundThread.removeTimeSliceClient (this);
+}
+
+Range<int64> BidirectionalBufferingSource::getBufferedRange() const
+{
+    const ScopedLock sl (bufferRangeLock);
+    return bufferValidRange;
+}
+
+void BidirectionalBufferingSource::discardBuffered() noexcept
+{
+    const ScopedLock sl (bufferRangeLock);
+
+    bufferValidRange = {};
+    ++numDiscards;
+}
+
+void BidirectionalBufferingSource::readBuffered (AudioBuffer<float>& dest, int destStart, int numSamples, int64 position) const
+{
+    const ScopedLock sl (bufferRangeLock);
+
+    if (isPrepared)
+        copyFromBuffer (dest, destStart, numSamples, position, false);
+    else
+        dest.clear (destStart, numSamples);
+}
+
+//==============================================================================
+void BidirectionalBufferingSource::prepareToPlay (int samplesPerBlockExpected, double sampleRate)
+{
+    const auto bufferSize = jmax (samplesPerBlockExpected * 2, numberOfSamplesToBuffer);
+
+    backgroundThread.removeTimeSliceClient (this);
+    source->prepareToPlay (samplesPerBlockExpected, sampleRate);
+
+    // What's buffered is counted in the source's samples, so it stays valid whatever the
+    // output rate is. A device restart only starts over if the buffer has become too small.
+    if (isPrepared && buffer.getNumSamples() >= bufferSize)
+    {
+        backgroundThread.addTimeSliceClient (this);
+        return;
+    }
+
+    {
+        const ScopedLock sl (bufferRangeLock);
+
+        buffer.setSize (numberOfChannels, bufferSize);
+        bufferValidRange = {};
+        isPrepared = true;
+    }
+
+    chunk.setSize (numberOfChannels, chunkSize);
+
+    while (readNextChunk())
+    {}
+
+    backgroundThread.addTimeSliceClient (this);
+}
+
+void BidirectionalBufferingSource::releaseResources()
+{
+    // The buffer and what's in it are kept, so that the next prepareToPlay() after a device
+    // change doesn't have to decode it all again. It's freed along with this object.
+    backgroundThread.removeTimeSliceClient (this);
+    source->releaseResources();
+}
+
+void BidirectionalBufferingSource::getNextAudioBlock (const AudioSourceChannelInfo& info)
+{
+    auto position = nextPlayPos.load();
+    const auto backwards = reverse.load();
+
+    {
+        const ScopedLock sl (bufferRangeLock);
+
+        if (! isPrepared)
+        {
+            info.clearActiveBufferRegion();
+            return;
+        }
+
+        copyFromBuffer (*info.buffer, info.startSample, info.numSamples, position, backwards);
+    }
+
+    for (int ch = numberOfChannels; ch < info.buffer->getNumChannels(); ++ch)
+        info.buffer->clear (ch, info.startSample, info.numSamples);
+
+    // turning around jumps to a different part of the waveform, so fade in over it
+    if (backwards != wasReverse)
+    {
+        const auto fade = jmin (directionFadeLength, info.numSamples);
+
+        for (int ch = 0; ch < info.buffer->getNumChannels(); ++ch)
+            info.buffer->applyGainRamp (ch, info.startSample, fade, 0.0f, 1.0f);
+
+        wasReverse = backwards;
+    }
+
+    const auto newPosition = backwards ? jmax ((int64) -1, position - info.numSamples)
+                                       : position + info.numSamples;
+
+    // a seek that came in while this block was being read wins
+    nextPlayPos.compare_exchange_strong (position, newPosition);
+}
+
+void BidirectionalBufferingSource::setNextReadPosition (int64 newPosition)
+{
+    nextPlayPos = newPosition;
+    backgroundThread.moveToFrontOfQueue (this);
+}
+
+//==============================================================================
+int BidirectionalBufferingSource::useTimeSlice()
+{
+    return readNextChunk() ? 1 : 20;
+}
+
+Range<int64> BidirectionalBufferingSource::getWantedRange (int64 playPosition, bool backwards) const noexcept
+{
+    const auto size = (int64) buffer.getNumSamples();
+    const auto ahead = size * 3 / 4;
+    const auto behind = size - ahead;
+
+    // going backwards the playhead is the last sample of the window's ahead part
+    const auto wanted = backwards ? Range<int64> (playPosition + 1 - ahead, playPosition + 1 + behind)
+                                  : Range<int64> (playPosition - behind, playPosition + ahead);
+
+    return wanted.getIntersectionWith ({ 0, source->getTotalLength() });
+}
+
+bool BidirectionalBufferingSource::readNextChunk()
+{
+    const ScopedLock rl (readLock);
+
+    const auto size = (int64) buffer.getNumSamples();
+
+    if (size == 0)
+        return false;
+
+    const auto position = nextPlayPos.load();
+    const auto backwards = reverse.load();
+
+    // the edge the window grows from: the playhead, or the sample just after it when
+    // going backwards
+    const auto playhead = backwards ? position + 1 : position;
+
+    Range<int64> valid;
+    int discards;
+
+    {
+        const ScopedLock sl (bufferRangeLock);
+        valid = bufferValidRange;
+        discards = numDiscards;
+    }
+
+    if (remapSource != nullptr)
+    {
+        const auto from = jmax (playhead, jmin (valid.getEnd(), playhead + remapMargin));
+
+        if (remapSource (from))
+        {
+            valid = valid.getStart() < from ? valid.getIntersectionWith ({ valid.getStart(), from })
+                                            : Range<int64> (from, from);
+
+            if (! setValidRange (valid, discards))
+                return true;
+        }
+    }
+
+    const auto wanted = getWantedRange (position, backwards);
+
+    if (wanted.isEmpty())
+        return false;
+
+    const auto anchor = wanted.clipValue (playhead);
+
+    if (anchor < valid.getStart() || anchor > valid.getEnd())
+    {
+        // the playhead jumped out of the buffered window, start a new one around it
+        valid = { anchor, anchor };
+
+        if (! setValidRange (valid, discards))
+            return true;
+    }
+
+    const auto canGrowUp = valid.getEnd() < wanted.getEnd();
+    const auto canGrowDown = valid.getStart() > wanted.getStart();
+
+    if (! (canGrowUp || canGrowDown))
+        return false;
+
+    // the side ahead of the playhead is always filled first
+    const auto growUp = backwards ? ! canGrowDown : canGrowUp;
+
+    const auto toRead = growUp ? Range<int64> (valid.getEnd(), jmin (valid.getEnd() + chunkSize, wanted.getEnd()))
+                               : Range<int64> (jmax (valid.getStart() - chunkSize, wanted.getStart()), valid.getStart());
+
+    const auto numToRead = (int) toRead.getLength();
+
+    // The part of the ring the chunk goes into is taken out of the buffered range before
+    // it's written, so the audio thread never copies from it meanwhile and the lock is
+    // only held for the range updates.
+    const auto kept = growUp ? Range<int64> (jmax (valid.getStart(), toRead.getEnd() - size), valid.getEnd())
+                             : Range<int64> (valid.getStart(), jmin (valid.getEnd(), toRead.getStart() + size));
+
+    if (! setValidRange (kept, discards))
+        return true;
+
+    source->setNextReadPosition (toRead.getStart());
+    source->getNextAudioBlock (AudioSourceChannelInfo (&chunk, 0, numToRead));
+
+    for (int done = 0; done < numToRead;)
+    {
+        const auto index = (int) ((toRead.getStart() + done) % size);
+        const auto num = jmin (numToRead - done, (int) size - index);
+
+        for (int ch = 0; ch < numberOfChannels; ++ch)
+            buffer.copyFrom (ch, index, chunk, ch, done, num);
+
+        done += num;
+    }
+
+    // a discard that came in while reading wins, the chunk may have been read before it
+    setValidRange (growUp ? Range<int64> (kept.getStart(), toRead.getEnd())
+                          : Range<int64> (toRead.getStart(), kept.getEnd()), discards);
+
+    return true;
+}
+
+bool BidirectionalBufferingSource::setValidRange (Range<int64> range, int discards)
+{
+    const ScopedLock sl (bufferRangeLock);
+
+    if (numDiscards != discards)
+        return false;
+
+    bufferValidRange = range;
+    return true;
+}
+
+void BidirectionalBufferingSource::copyFromBuffer (AudioBuffer<float>& dest, int destStart, int numSamples,
+                                                   int64 position, bool backwards) const noexcept
+{
+    const auto size = buffer.getNumSamples();
+    const auto numChannels = jmin (numberOfChannels, dest.getNumChannels());
+
+    // the source samples this block covers, in ascending order
+    const auto covered = backwards ? Range<int64> (position - numSamples + 1, position + 1)
+                                   : Range<int64> (position, position + numSamples);
+
+    const auto available = covered.getIntersectionWith (bufferValidRange);
+
+    if (available != covered)
+        for (int ch = 0; ch < numChannels; ++ch)
+            dest.clear (ch, destStart, numSamples);
+
+    for (auto pos = available.getStart(); pos < available.getEnd();)
+    {
+        const auto index = (int) (pos % size);
+        const auto num = (int) jmin (available.getEnd() - pos, (int64) (size - index));
+
+        if (backwards)
+        {
+            // the sample at the playhead goes first, then on down through the file
+            const auto last = destStart + (int) (position - pos);
+
+            for (int ch = 0; ch < numChannels; ++ch)
+            {
+                const auto* src = buffer.getReadPointer (ch, index);
+                auto* d = dest.getWritePointer (ch);
+
+                for (int i = 0; i < num; ++i)
+                    d[last - i] = src[i];
+            }
+        }
+        else
+        {
+            for (int ch = 0; ch < numChannels; ++ch)
+                dest.copyFrom (ch, destStart + (int) (pos - position), buffer, ch, index, num);
+        }
+
+        pos += num;
+    }
+}
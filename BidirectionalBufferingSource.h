@@ -0,0 +1,115 @@
+#pragma once
+
+#include "EngineModules.h"
+
+/** A read-ahead buffer like BufferingAudioSource, but one that can also play backwards.
+
+    A window of decoded audio is kept around the playhead and filled on a
+    TimeSliceThread. The window leans towards the direction of travel, three quarters
+    ahead of the playhead and one quarter behind it, and the side ahead is always
+    filled first. Reversing, or scrubbing back and forth over recent material, is
+    then served from memory, and a seek into the buffered window costs nothing.
+
+    The audio thread only holds the buffer lock while copying out of memory. The
+    background thread only holds it to update the range that's buffered: it reads the
+    source and writes into the buffer outside of it, into a part that it has taken out
+    of that range first, so the audio thread never waits for a read or a copy.
+*/
+class BidirectionalBufferingSource final : public PositionableAudioSource,
+                                           private TimeSliceClient
+{
+public:
+    BidirectionalBufferingSource (PositionableAudioSource* source,
+                                  TimeSliceThread& backgroundThread,
+                                  int numberOfSamplesToBuffer,
+                                  int numberOfChannels = 2);
+
+    ~BidirectionalBufferingSource() override;
+
+    /** Plays the source backwards when true. Can be called from any thread.
+
+        This only turns the playhead around where it is. A source that maps read positions
+        onto something else, like a LoopingReaderSource, should have the playhead moved
+        onto the position it maps to first.
+    */
+    void setReverse (bool shouldPlayBackwards) noexcept    { reverse = shouldPlayBackwards; }
+    bool isReverse() const noexcept                         { return reverse; }
+
+    /** Called on the background thread before each read, with a position a little way past
+        the playhead. If it returns true, the source now reads something else from there on,
+        so whatever was buffered past it is thrown away and read again, while the audio before
+        it plays out as it was.
+    */
+    std::function<bool (int64 position)> remapSource;
+
+    /** Throws away everything that's buffered, e.g. because the source has started reading
+        something else at the same positions. Any thread.
+    */
+    void discardBuffered() noexcept;
+
+    /** Returns the range of source samples that is currently held in memory. */
+    Range<int64> getBufferedRange() const;
+
+    /** Copies samples in file order straight out of the buffer, without moving the playhead.
+        Anything that isn't buffered yet reads as silence.
+    */
+    void readBuffered (AudioBuffer<float>& dest, int destStart, int numSamples, int64 position) const;
+
+    /** Moves the playhead and the direction the window leans in, without waking the
+        background thread. Meant for a scrub, which moves it a little on every block.
+    */
+    void movePlayhead (int64 newPosition, bool backwards) noexcept
+    {
+        nextPlayPos = newPosition;
+        reverse = backwards;
+    }
+
+    //==============================================================================
+    /** Fills the window around the playhead before returning, unless it's still there
+        from an earlier call.
+    */
+    void prepareToPlay (int samplesPerBlockExpected, double sampleRate) override;
+
+    /** Stops reading ahead, but keeps the buffer for the next prepareToPlay(). */
+    void releaseResources() override;
+    void getNextAudioBlock (const AudioSourceChannelInfo& bufferToFill) override;
+
+    /** When playing backwards, the next read position is the next sample to be played, and
+        it goes down to -1 once the start of the source has been played.
+    */
+    void setNextReadPosition (int64 newPosition) override;
+    int64 getNextReadPosition() const override      { return nextPlayPos; }
+    int64 getTotalLength() const override           { return source->getTotalLength(); }
+    bool isLooping() const override                 { return source->isLooping(); }
+
+private:
+    int useTimeSlice() override;
+    bool readNextChunk();
+    bool setValidRange (Range<int64> range, int discards);
+    Range<int64> getWantedRange (int64 playPosition, bool backwards) const noexcept;
+    void copyFromBuffer (AudioBuffer<float>& dest, int destStart, int numSamples, int64 position, bool backwards) const noexcept;
+
+    static constexpr int chunkSize = 8192;
+
+    // far enough past the playhead for what follows a remap to be read before it's played
+    static constexpr int remapMargin = 4096;
+    static constexpr int directionFadeLength = 64;
+
+    PositionableAudioSource* source;
+    TimeSliceThread& backgroundThread;
+    const int numberOfSamplesToBuffer, numberOfChannels;
+
+    AudioBuffer<float> buffer, chunk;
+    CriticalSection bufferRangeLock, readLock;
+    Range<int64> bufferValidRange;
+    int numDiscards = 0;
+    bool isPrepared = false;
+
+    std::atomic<int64> nextPlayPos { 0 };
+    std::atomic<bool> reverse { false };
+
+    // audio thread only
+    bool wasReverse = false;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (BidirectionalBufferingSource)
+};
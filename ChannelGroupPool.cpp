@@ -0,0 +1,160 @@
+#include "ChannelGroupPool.h"
+#include "RealtimeSetup.h"
+
+class ChannelGroupPool::Worker final : public Thread
+{
+public:
+    explicit Worker (ChannelGroupPool& p)
+        : Thread ("Channel Group Worker"),
+          pool (p),
+          spinTicks (Time::secondsToHighResolutionTicks (spinSeconds))
+    {
+        startRealtimeThread (RealtimeOptions{}.withPriority (9));
+    }
+
+    ~Worker() override
+    {
+        signalThreadShouldExit();
+        wakeUp.signal();
+        stopThread (1000);
+    }
+
+    WaitableEvent wakeUp;
+
+private:
+    void run() override
+    {
+        RealtimeSetup::applyToCurrentThread (RealtimeSetup::workerThreads);
+
+        auto lastGeneration = pool.generation.load (std::memory_order_acquire);
+
+        while (! threadShouldExit())
+        {
+            const auto current = pool.generation.load (std::memory_order_acquire);
+
+            if (current != lastGeneration)
+            {
+                lastGeneration = current;
+                pool.runJobs();
+                continue;
+            }
+
+            // only in case another batch follows straight away: at real-time priority, any
+            // longer would take that time from the disk and background threads every block
+            const auto spinUntil = Time::getHighResolutionTicks() + spinTicks;
+
+            while (Time::getHighResolutionTicks() < spinUntil
+                    && pool.generation.load (std::memory_order_acquire) == lastGeneration)
+            {}
+
+            // The worker says it's going to sleep before it looks at the generation one last
+            // time, and run() publishes a batch before it looks for sleepers. Both sides do
+            // this with sequentially consistent operations, so either the worker sees the
+            // batch or run() sees the worker and wakes it.
+            pool.numSleeping.fetch_add (1, std::memory_order_seq_cst);
+
+            if (pool.generation.load (std::memory_order_seq_cst) == lastGeneration)
+                wakeUp.wait (100);
+
+            pool.numSleeping.fetch_sub (1, std::memory_order_seq_cst);
+        }
+    }
+
+    static constexpr double spinSeconds = 5.0e-6;
+
+    ChannelGroupPool& pool;
+    const int64 spinTicks;
+};
+
+//==============================================================================
+ChannelGroupPool::ChannelGroupPool (int numWorkers)
+{
+    for (int i = 0; i < numWorkers; ++i)
+        workers.add (new Worker (*this));
+}
+
+ChannelGroupPool::~ChannelGroupPool()
+{
+    workers.clear();
+}
+
+int ChannelGroupPool::getDefaultNumWorkers()
+{
+    // leave a core for the message thread and one for everything else
+    return jlimit (0, 3, SystemStats::getNumCpus() - 2);
+}
+
+void ChannelGroupPool::run (int numJobs, void (*invoke) (void*, int), void* context) noexcept
+{
+    if (numJobs <= 0)
+        return;
+
+    // probing runs a few blocks the other way, to keep both timings up to date
+    const auto runInParallel = (parallel != (probeRunsLeft > 0)) && numJobs > 1 && ! workers.isEmpty();
+    const auto start = Time::getHighResolutionTicks();
+
+    if (runInParallel)
+    {
+        batchInvoke = invoke;
+        batchContext = context;
+        jobsRemaining.store (numJobs, std::memory_order_relaxed);
+
+        // A worker that is late leaving the previous batch picks this one up from here. Any
+        // claim it made before this store came with the previous batch's count and is past
+        // the end of it, so it can't run a job of this batch a second time.
+        nextJob.store ((uint64) numJobs << 32, std::memory_order_release);
+
+        generation.fetch_add (1, std::memory_order_seq_cst);
+
+        if (numSleeping.load (std::memory_order_seq_cst) > 0)
+            for (auto* worker : workers)
+                worker->wakeUp.signal();
+
+        runJobs();
+
+        while (jobsRemaining.load (std::memory_order_acquire) > 0)
+        {}
+    }
+    else
+    {
+        for (int i = 0; i < numJobs; ++i)
+            invoke (context, i);
+    }
+
+    if (numJobs > 1 && ! workers.isEmpty())
+        chooseMode (runInParallel, Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - start));
+}
+
+void ChannelGroupPool::runJobs() noexcept
+{
+    for (;;)
+    {
+        const auto claim = nextJob.fetch_add (1, std::memory_order_acq_rel);
+        const auto index = (int) (claim & 0xffffffff);
+
+        if (index >= (int) (claim >> 32))
+            return;
+
+        batchInvoke (batchContext, index);
+        jobsRemaining.fetch_sub (1, std::memory_order_acq_rel);
+    }
+}
+
+void ChannelGroupPool::chooseMode (bool ranInParallel, double seconds) noexcept
+{
+    auto& cost = ranInParallel ? parallelCost : serialCost;
+    cost = cost > 0.0 ? cost + (seconds - cost) * 0.1 : seconds;
+
+    if (probeRunsLeft > 0)
+    {
+        --probeRunsLeft;
+    }
+    else if (++runsSinceProbe >= probeInterval || (ranInParallel ? serialCost : parallelCost) <= 0.0)
+    {
+        runsSinceProbe = 0;
+        probeRunsLeft = probeLength;
+    }
+
+    if (probeRunsLeft == 0 && serialCost > 0.0 && parallelCost > 0.0)
+        parallel = parallelCost < serialCost;
+}
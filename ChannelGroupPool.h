@@ -0,0 +1,65 @@
+#pragma once
+
+#include "EngineModules.h"
+
+/** Spreads the channel groups of one block over a few real-time worker threads.
+
+    run() is called on the audio thread. It hands the jobs to the workers, takes jobs
+    itself until there are none left, then waits for the ones still running. Between
+    batches the workers only spin for a few microseconds before they go to sleep, as
+    they run at real-time priority, and run() wakes them for the next one.
+
+    Waking threads and waiting for them has a cost of its own, which can be more than
+    the parallel work saves. The pool times both ways: it keeps to whichever is faster
+    on average, and every so often runs a few blocks the other way to check that this
+    is still true.
+*/
+class ChannelGroupPool final
+{
+public:
+    /** Starts numWorkers threads, on top of the thread that calls run(). */
+    explicit ChannelGroupPool (int numWorkers = getDefaultNumWorkers());
+    ~ChannelGroupPool();
+
+    /** Calls job (index) for every index in [0, numJobs) and returns when all are done. */
+    template <typename Job>
+    void run (int numJobs, Job&& job)
+    {
+        run (numJobs, [] (void* context, int index) { (*static_cast<Job*> (context)) (index); }, &job);
+    }
+
+    void run (int numJobs, void (*invoke) (void*, int), void* context) noexcept;
+
+    /** True while the pool is running jobs on the workers rather than only on the caller. */
+    bool isRunningInParallel() const noexcept       { return parallel; }
+
+    static int getDefaultNumWorkers();
+
+private:
+    class Worker;
+
+    void runJobs() noexcept;
+    void chooseMode (bool ranInParallel, double seconds) noexcept;
+
+    static constexpr int probeInterval = 512;
+    static constexpr int probeLength = 8;
+
+    OwnedArray<Worker> workers;
+
+    // the current batch, published by the audio thread
+    std::atomic<uint32> generation { 0 };
+    std::atomic<int> jobsRemaining { 0 }, numSleeping { 0 };
+
+    // the number of jobs in the batch in the top half and the next one to claim in the
+    // bottom, so that every claim is checked against the count of the batch it came from
+    std::atomic<uint64> nextJob { 0 };
+    void (*batchInvoke) (void*, int) = nullptr;
+    void* batchContext = nullptr;
+
+    // audio thread only
+    bool parallel = false;
+    int runsSinceProbe = 0, probeRunsLeft = 0;
+    double serialCost = 0.0, parallelCost = 0.0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ChannelGroupPool)
+};
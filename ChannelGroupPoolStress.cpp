@@ -0,0 +1,75 @@
+#include "EngineModules.h"
+#include "ChannelGroupPool.h"
+
+#include <cstdio>
+
+/*  Runs a ChannelGroupPool through many small batches, the way the pitch shifter does
+    on every block, and checks that every job of every batch ran exactly once:
+
+        ChannelGroupPoolStress
+
+    The jobs are long enough for the workers to be worth using, and now and then the
+    batches pause for long enough that the workers go to sleep and have to be woken.
+    It exits with a non-zero status if any job was missed or ran twice.
+*/
+
+int main()
+{
+    constexpr int numBatches = 200000;
+    constexpr int maxJobs = 16;
+    constexpr int batchesBetweenPauses = 64;
+
+    ChannelGroupPool pool (3);
+    std::array<std::atomic<int>, maxJobs> runs;
+
+    // one result per job, which keeps the optimiser from dropping the work they do
+    std::array<volatile float, maxJobs> results {};
+    Random random (1);
+
+    int failures = 0, parallelBatches = 0;
+
+    for (int batch = 0; batch < numBatches; ++batch)
+    {
+        const auto numJobs = 2 + random.nextInt (maxJobs - 1);
+
+        for (auto& r : runs)
+            r.store (0, std::memory_order_relaxed);
+
+        pool.run (numJobs, [&runs, &results] (int index)
+        {
+            runs[(size_t) index].fetch_add (1, std::memory_order_relaxed);
+
+            auto x = (float) index;
+
+            for (int i = 0; i < 500; ++i)
+                x = x * 0.999f + 1.0f;
+
+            results[(size_t) index] = x;
+        });
+
+        // run() has returned, so every job of this batch has to be done by now, and a
+        // worker that was late leaving the previous batch mustn't have run one again
+        for (int i = 0; i < maxJobs; ++i)
+        {
+            const auto expected = i < numJobs ? 1 : 0;
+            const auto actual = runs[(size_t) i].load (std::memory_order_relaxed);
+
+            if (actual != expected)
+            {
+                if (++failures <= 10)
+                    std::printf ("batch %d: job %d of %d ran %d times\n", batch, i, numJobs, actual);
+            }
+        }
+
+        if (pool.isRunningInParallel())
+            ++parallelBatches;
+
+        if (batch % batchesBetweenPauses == 0)
+            Thread::sleep (1);
+    }
+
+    std::printf ("%d batches, %d of them on the workers, %d failures\n",
+                 numBatches, parallelBatches, failures);
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "EngineModules.h"
+#include "DspArena.h"
+
+/** A whole-sample delay that lines up a bypassed path with a stage that has latency.
+    Its delay lines are carved out of a DspArena.
+*/
+class CompensationDelay final
+{
+public:
+    explicit CompensationDelay (int delayInSamples)
+        : delay (delayInSamples),
+          size (nextPowerOfTwo (delayInSamples + 1)),
+          mask (size - 1)
+    {
+    }
+
+    size_t getRequiredBytes (const dsp::ProcessSpec& spec) const noexcept
+    {
+        return spec.numChannels * DspArena::getAlignedSize<float> ((size_t) size);
+    }
+
+    void prepare (const dsp::ProcessSpec& spec, DspArena& arena)
+    {
+        lines.resize (spec.numChannels);
+
+        for (auto& line : lines)
+            line = arena.allocate<float> ((size_t) size);
+
+        reset();
+    }
+
+    void reset() noexcept
+    {
+        for (auto* line : lines)
+            FloatVectorOperations::clear (line, size);
+
+        writePosition = 0;
+    }
+
+    int getLatencySamples() const noexcept      { return delay; }
+
+    void process (const dsp::ProcessContextReplacing<float>& context) noexcept
+    {
+        auto& block = context.getOutputBlock();
+        const auto numSamples = (int) block.getNumSamples();
+        const auto numChannels = jmin (block.getNumChannels(), lines.size());
+
+        for (size_t ch = 0; ch < numChannels; ++ch)
+        {
+            auto* samples = block.getChannelPointer (ch);
+            auto* line = lines[ch];
+
+            for (int i = 0; i < numSamples; ++i)
+            {
+                const auto index = (writePosition + i) & mask;
+                line[index] = samples[i];
+                samples[i] = line[(index - delay) & mask];
+            }
+        }
+
+        writePosition = (writePosition + numSamples) & mask;
+    }
+
+private:
+    const int delay, size, mask;
+
+    std::vector<float*> lines;
+    int writePosition = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (CompensationDelay)
+};
@@ -36,8 +36,38 @@ struct DSPDemoParameterBase    : public ChangeBroadcaster
     virtual int getPreferredHeight()  = 0;
     virtual int getPreferredWidth()   = 0;
 
+    virtual double getRawValue() const = 0;
+
+    /** Returns true if the value differs from the one seen by the previous call.
+        Any number of UI changes between two calls collapse into a single update.
+    */
+    bool pullChange()
+    {
+        if (! changed.exchange (false))
+            return false;
+
+        const auto value = getRawValue();
+
+        if (exactlyEqual (value, lastPulledValue))
+            return false;
+
+        lastPulledValue = value;
+        return true;
+    }
+
     String name;
 
+protected:
+    void markChanged()
+    {
+        changed = true;
+        sendChangeMessage();
+    }
+
+private:
+    std::atomic<bool> changed { true };
+    double lastPulledValue = std::numeric_limits<double>::quiet_NaN();
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (DSPDemoParameterBase)
 };
 
@@ -55,7 +85,7 @@ struct SliderParameter final : public DSPDemoParameterBase
         if (suffix.isNotEmpty())
             slider.setTextValueSuffix (suffix);
 
-        slider.onValueChange = [this] { sendChangeMessage(); };
+        slider.onValueChange = [this] { markChanged(); };
     }
 
     Component* getComponent() override    { return &slider; }
@@ -64,6 +94,13 @@ struct SliderParameter final : public DSPDemoParameterBase
     int getPreferredWidth()  override     { return 500; }
 
     double getCurrentValue() const        { return slider.getValue(); }
+    double getRawValue() const override   { return getCurrentValue(); }
+
+    /** Moves the slider. With dontSendNotification the change isn't passed on to the DSP. */
+    void setCurrentValue (double newValue, NotificationType notification = sendNotificationSync)
+    {
+        slider.setValue (newValue, notification);
+    }
 
 private:
     Slider slider;
@@ -76,7 +113,7 @@ struct ChoiceParameter final : public DSPDemoParameterBase
         : DSPDemoParameterBase (labelName)
     {
         parameterBox.addItemList (options, 1);
-        parameterBox.onChange = [this] { sendChangeMessage(); };
+        parameterBox.onChange = [this] { markChanged(); };
 
         parameterBox.setSelectedId (initialId);
     }
@@ -87,6 +124,13 @@ struct ChoiceParameter final : public DSPDemoParameterBase
     int getPreferredWidth()  override     { return 250; }
 
     int getCurrentSelectedID() const      { return parameterBox.getSelectedId(); }
+    double getRawValue() const override   { return getCurrentSelectedID(); }
+
+    /** Selects an item. With dontSendNotification the change isn't passed on to the DSP. */
+    void setCurrentSelectedID (int newId, NotificationType notification = sendNotificationSync)
+    {
+        parameterBox.setSelectedId (newId, notification);
+    }
 
 private:
     ComboBox parameterBox;
@@ -100,9 +144,8 @@ class AudioThumbnailComponent final : public Component,
                                       private Timer
 {
 public:
-    AudioThumbnailComponent (AudioDeviceManager& adm, AudioFormatManager& afm)
-        : audioDeviceManager (adm),
-          thumbnailCache (5),
+    AudioThumbnailComponent (AudioFormatManager& afm)
+        : thumbnailCache (5),
           thumbnail (128, afm, thumbnailCache)
     {
         thumbnail.addChangeListener (this);
@@ -124,6 +167,15 @@ public:
             thumbnail.drawChannels (g, getLocalBounds().reduced (2),
                                     0.0, thumbnail.getTotalLength(), 1.0f);
 
+            if (! loopRegion.isEmpty())
+            {
+                const auto x1 = timeToX (loopRegion.getStart());
+                const auto x2 = timeToX (loopRegion.getEnd());
+
+                g.setColour (Colours::yellow.withAlpha (0.25f));
+                g.fillRect (x1, 0.0f, x2 - x1, static_cast<float> (getHeight()));
+            }
+
             g.setColour (Colours::black);
             g.fillRect (static_cast<float> (currentPosition * getWidth()), 0.0f,
                         1.0f, static_cast<float> (getHeight()));
@@ -136,7 +188,16 @@ public:
     }
 
     bool isInterestedInFileDrag (const StringArray&) override          { return true; }
-    void filesDropped (const StringArray& files, int, int) override    { loadURL (URL (File (files[0])), true); }
+
+    void filesDropped (const StringArray& files, int, int) override
+    {
+        droppedQueue.clearQuick();
+
+        for (int i = 1; i < files.size(); ++i)
+            droppedQueue.add (URL (File (files[i])));
+
+        loadURL (URL (File (files[0])), true);
+    }
 
     void setCurrentURL (const URL& u)
     {
@@ -148,9 +209,17 @@ public:
 
     URL getCurrentURL() const   { return currentURL; }
 
-    void setTransportSource (AudioTransportSource* newSource)
+    /** Returns the files that were dropped after the first one, in order. */
+    const Array<URL>& getDroppedQueue() const   { return droppedQueue; }
+
+    /** Called with the loop region after it has been edited. Shift-dragging selects a region,
+        double-clicking clears it.
+    */
+    std::function<void (Range<double>)> onLoopRegionChanged;
+
+    void setPlaybackSource (TrackSwitcher* newSource)
     {
-        transportSource = newSource;
+        playbackSource = newSource;
 
         struct ResetCallback final : public CallbackMessage
         {
@@ -164,14 +233,20 @@ public:
     }
 
 private:
-    AudioDeviceManager& audioDeviceManager;
     AudioThumbnailCache thumbnailCache;
     AudioThumbnail thumbnail;
-    AudioTransportSource* transportSource = nullptr;
+    TrackSwitcher* playbackSource = nullptr;
 
     URL currentURL;
+    Array<URL> droppedQueue;
     double currentPosition = 0.0;
 
+    Range<double> loopRegion;
+    double loopDragStart = -1.0;
+
+    bool isScrubbing = false;
+    double scrubOffset = 0.0;
+
     //==============================================================================
     void changeListenerCallback (ChangeBroadcaster*) override    { repaint(); }
 
@@ -180,7 +255,7 @@ private:
         currentPosition = 0.0;
         repaint();
 
-        if (transportSource == nullptr)
+        if (playbackSource == nullptr)
             stopTimer();
         else
             startTimerHz (25);
@@ -192,6 +267,7 @@ private:
             return;
 
         currentURL = u;
+        loopRegion = {};
 
         thumbnail.setSource (makeInputSource (u).release());
 
@@ -201,23 +277,246 @@ private:
 
     void timerCallback() override
     {
-        if (transportSource != nullptr)
+        if (playbackSource != nullptr)
         {
-            currentPosition = transportSource->getCurrentPosition() / thumbnail.getTotalLength();
+            currentPosition = playbackSource->getAudiblePosition() / thumbnail.getTotalLength();
             repaint();
         }
     }
 
+    float timeToX (double time) const
+    {
+        return static_cast<float> (time / thumbnail.getTotalLength() * getWidth());
+    }
+
+    double xToTime (int x) const
+    {
+        return jlimit (0.0, 1.0, static_cast<double> (x) / getWidth()) * thumbnail.getTotalLength();
+    }
+
+    void mouseDown (const MouseEvent& e) override
+    {
+        loopDragStart = e.mods.isShiftDown() ? xToTime (e.x) : -1.0;
+
+        // the scrub grabs the playhead where it is, the drag then moves it relative to that
+        if (playbackSource != nullptr)
+            scrubOffset = playbackSource->getCurrentPosition() - xToTime (e.x);
+    }
+
     void mouseDrag (const MouseEvent& e) override
     {
-        if (transportSource != nullptr)
+        if (loopDragStart >= 0.0)
+        {
+            const auto time = xToTime (e.x);
+            loopRegion = { jmin (loopDragStart, time), jmax (loopDragStart, time) };
+            repaint();
+        }
+        else if (playbackSource != nullptr)
+        {
+            if (! isScrubbing)
+                playbackSource->beginScrub();
+
+            isScrubbing = true;
+            playbackSource->scrubTo (jmax (0.0, xToTime (e.x) + scrubOffset));
+        }
+    }
+
+    void mouseUp (const MouseEvent& e) override
+    {
+        if (loopDragStart >= 0.0 && onLoopRegionChanged != nullptr)
+            onLoopRegionChanged (loopRegion);
+
+        if (playbackSource != nullptr)
+        {
+            if (isScrubbing)
+                playbackSource->endScrub();
+            else if (loopDragStart < 0.0 && ! e.mouseWasDraggedSinceMouseDown())
+                playbackSource->setPosition (xToTime (e.x));
+        }
+
+        loopDragStart = -1.0;
+        isScrubbing = false;
+    }
+
+    void mouseDoubleClick (const MouseEvent&) override
+    {
+        loopRegion = {};
+        repaint();
+
+        if (onLoopRegionChanged != nullptr)
+            onLoopRegionChanged (loopRegion);
+    }
+};
+
+//==============================================================================
+/** Shows the latest frame from a SpectrumAnalyser on a log frequency scale.
+
+    A new frame is drawn into a cached image when the timer picks it up, so paint() only
+    has to blit that, however often it's called.
+*/
+class SpectrumComponent final : public Component,
+                                private Timer
+{
+public:
+    explicit SpectrumComponent (SpectrumAnalyser& a)
+        : analyser (a)
+    {
+        setOpaque (true);
+        levels.fill (SpectrumAnalyser::minimumDecibels);
+        startTimerHz (30);
+    }
+
+    void paint (Graphics& g) override
+    {
+        if (cachedImage.isNull())
+            renderImage();
+
+        g.drawImageAt (cachedImage, 0, 0);
+    }
+
+    void resized() override
+    {
+        cachedImage = {};
+    }
+
+private:
+    void timerCallback() override
+    {
+        if (analyser.getLatestSpectrum (levels))
+        {
+            renderImage();
+            repaint();
+        }
+    }
+
+    void renderImage()
+    {
+        if (getWidth() <= 0 || getHeight() <= 0)
+            return;
+
+        if (cachedImage.getWidth() != getWidth() || cachedImage.getHeight() != getHeight())
+            cachedImage = Image (Image::RGB, getWidth(), getHeight(), false);
+
+        Graphics g (cachedImage);
+        g.fillAll (Colour (0xff495358));
+
+        const auto width = (float) getWidth();
+        const auto height = (float) getHeight();
+        const auto binWidth = analyser.getSampleRate() / SpectrumAnalyser::fftSize;
+
+        Path spectrum;
+        spectrum.startNewSubPath (0.0f, height);
+
+        for (int x = 0; x < getWidth(); ++x)
+        {
+            const auto frequency = minFrequency * std::pow (maxFrequency / minFrequency, x / (double) width);
+            const auto bin = jlimit (0, SpectrumAnalyser::numBins - 1, roundToInt (frequency / binWidth));
+            const auto level = levels[(size_t) bin];
+
+            spectrum.lineTo ((float) x, jmap (level, SpectrumAnalyser::minimumDecibels, 0.0f, height, 0.0f));
+        }
+
+        spectrum.lineTo (width, height);
+        spectrum.closeSubPath();
+
+        g.setColour (Colours::white.withAlpha (0.6f));
+        g.fillPath (spectrum);
+    }
+
+    static constexpr double minFrequency = 20.0;
+    static constexpr double maxFrequency = 20000.0;
+
+    SpectrumAnalyser& analyser;
+    std::array<float, SpectrumAnalyser::numBins> levels;
+    Image cachedImage;
+};
+
+//==============================================================================
+/** Shows a bar for each channel of a LevelMeter: the RMS level filled in, and the peak as a
+    line above it, on a scale from -60 dB to 0 dB.
+
+    The levels are checked on every frame the display shows, and only when one of them has
+    moved far enough to change what's drawn does the component repaint, and then only itself.
+*/
+class LevelMeterComponent final : public Component
+{
+public:
+    explicit LevelMeterComponent (LevelMeter& m)
+        : meter (m)
+    {
+        setOpaque (true);
+    }
+
+    void paint (Graphics& g) override
+    {
+        g.fillAll (Colour (0xff495358));
+
+        const auto numChannels = jmax (1, shown.size());
+        auto bounds = getLocalBounds().reduced (2);
+        const auto barWidth = bounds.getWidth() / numChannels;
+
+        for (int ch = 0; ch < shown.size(); ++ch)
+        {
+            auto bar = bounds.removeFromLeft (barWidth).reduced (1, 0).toFloat();
+            const auto rmsY = levelToY (shown[ch].rms, bar);
+            const auto peakY = levelToY (shown[ch].peak, bar);
+
+            g.setColour (shown[ch].peak >= 1.0f ? Colours::red : Colour (0xff79ed7f));
+            g.fillRect (bar.withTop (rmsY));
+
+            g.setColour (Colours::white);
+            g.fillRect (bar.getX(), peakY, bar.getWidth(), 1.0f);
+        }
+    }
+
+private:
+    struct Levels
+    {
+        float peak = 0.0f, rms = 0.0f;
+    };
+
+    void update()
+    {
+        const auto numChannels = meter.getNumChannels();
+        auto changed = numChannels != shown.size();
+
+        shown.resize (numChannels);
+
+        for (int ch = 0; ch < numChannels; ++ch)
         {
-            const ScopedLock sl (audioDeviceManager.getAudioCallbackLock());
+            const Levels latest { meter.getPeak (ch), meter.getRMS (ch) };
+            auto& current = shown.getReference (ch);
+
+            // a change of less than a pixel isn't worth a repaint
+            const auto threshold = 1.0f / (float) jmax (1, getHeight());
 
-            transportSource->setPosition ((jmax (static_cast<double> (e.x), 0.0) / getWidth())
-                                            * thumbnail.getTotalLength());
+            if (std::abs (levelToProportion (latest.peak) - levelToProportion (current.peak)) >= threshold
+                 || std::abs (levelToProportion (latest.rms) - levelToProportion (current.rms)) >= threshold)
+            {
+                current = latest;
+                changed = true;
+            }
         }
+
+        if (changed)
+            repaint();
     }
+
+    static float levelToProportion (float gain) noexcept
+    {
+        return jmap (Decibels::gainToDecibels (gain, minimumDecibels), minimumDecibels, 0.0f, 0.0f, 1.0f);
+    }
+
+    static float levelToY (float gain, Rectangle<float> bar) noexcept
+    {
+        return bar.getBottom() - jlimit (0.0f, 1.0f, levelToProportion (gain)) * bar.getHeight();
+    }
+
+    static constexpr float minimumDecibels = -60.0f;
+
+    LevelMeter& meter;
+    Array<Levels> shown;
+    VBlankAttachment vBlank { this, [this] { update(); } };
 };
 
 //==============================================================================
@@ -273,68 +572,80 @@ private:
 };
 
 //==============================================================================
-template <class DemoType>
-struct DSPDemo final : public AudioSource,
-                       public ProcessorWrapper<DemoType>,
-                       private ChangeListener
+/** Drives a PlaybackEngine from a set of controls. Controls names the engine's chain as
+    its Processor, holds the parameters to show and maps them onto the chain with
+    parameterChanged(). Speed and direction go to the engine itself.
+*/
+template <class Controls>
+struct DSPDemo final : private ChangeListener,
+                       private Timer
 {
-    DSPDemo (AudioSource& input, juce::ResamplingAudioSource& inputResampling)
-        : inputSource (&input)
-        , resampleSource (&inputResampling)
+    static_assert (std::is_same_v<typename Controls::Processor, PlaybackEngine::Processor>);
+
+    explicit DSPDemo (PlaybackEngine& engineToDrive)
+        : engine (engineToDrive)
     {
         for (auto* p : getParameters())
             p->addChangeListener (this);
+
+        startTimerHz (parameterUpdateRateHz);
     }
 
-    void prepareToPlay (int blockSize, double sampleRate) override
+    ~DSPDemo() override
     {
-        inputSource->prepareToPlay (blockSize, sampleRate);
-        resampleSource->prepareToPlay (blockSize, sampleRate);
-        this->prepare ({ sampleRate, (uint32) blockSize, 2 });
+        for (auto* p : getParameters())
+            p->removeChangeListener (this);
     }
 
-    void releaseResources() override
+    const std::vector<DSPDemoParameterBase*>& getParameters()
     {
-        inputSource->releaseResources();
-        resampleSource->releaseResources();
+        return controls.parameters;
     }
 
-    void getNextAudioBlock (const AudioSourceChannelInfo& bufferToFill) override
+    /** Passes the tempo and key found in the current file on to the controls. */
+    void setTrackAnalysis (const TrackAnalysis& analysis)
     {
-        if (bufferToFill.buffer == nullptr)
-        {
-            jassertfalse;
-            return;
-        }
-
-        resampleSource->getNextAudioBlock (bufferToFill);
-
-        AudioBlock<float> block (*bufferToFill.buffer,
-                                 (size_t) bufferToFill.startSample);
-
-        ScopedLock audioLock (audioCallbackLock);
-        this->process (ProcessContextReplacing<float> (block));
+        controls.setTrackAnalysis (analysis);
     }
 
-    const std::vector<DSPDemoParameterBase*>& getParameters()
+private:
+    // Parameter changes are only collected here; they get pushed to the DSP
+    // at most once per UI frame by the timer below.
+    void changeListenerCallback (ChangeBroadcaster*) override
     {
-        return this->processor.parameters;
+        if (! isTimerRunning())
+            startTimerHz (parameterUpdateRateHz);
     }
 
-    void changeListenerCallback (ChangeBroadcaster*) override
+    void timerCallback() override
     {
-        ScopedLock audioLock (audioCallbackLock);
-        auto& processor = static_cast<DemoType&> (this->processor);
-        processor.updateParameters();
-        if (resampleSource) {
-            resampleSource->setResamplingRatio (processor.tempoParam.getCurrentValue());
+        auto anyChanged = false;
+
+        for (auto* p : getParameters())
+        {
+            if (! p->pullChange())
+                continue;
+
+            anyChanged = true;
+
+            if (p == &controls.tempoParam)
+                engine.setSpeed (controls.tempoParam.getCurrentValue());
+            else if (p == &controls.directionParam)
+                engine.setReverse (controls.directionParam.getCurrentSelectedID() == 2);
+            else
+                controls.parameterChanged (*p, engine.getProcessor());
         }
+
+        if (anyChanged)
+            engine.updateLatency();
+        else
+            stopTimer();
     }
 
-    CriticalSection audioCallbackLock;
+    static constexpr int parameterUpdateRateHz = 60;
 
-    AudioSource* inputSource;
-    juce::ResamplingAudioSource* resampleSource = nullptr;
+    PlaybackEngine& engine;
+    Controls controls;
 };
 
 //==============================================================================
@@ -348,20 +659,24 @@ public:
     //==============================================================================
     AudioFileReaderComponent()
         : TimeSliceThread ("Audio File Reader Thread"),
-          header (audioDeviceManager, formatManager, *this)
+          header (formatManager, *this)
     {
         loopState.addListener (this);
 
         formatManager.registerBasicFormats();
-        audioDeviceManager.addAudioCallback (&audioSourcePlayer);
-
-       #ifndef JUCE_DEMO_RUNNER
-        audioDeviceManager.initialiseWithDefaultDevices (0, 2);
-       #endif
 
         init();
         startThread();
 
+       #ifndef JUCE_DEMO_RUNNER
+        // Probing the audio devices can take a while, so it happens in the background and
+        // the window shows up straight away. The device is opened, and the player attached,
+        // back on the message thread once the probe is done.
+        deviceOpener.startThread();
+       #else
+        audioDeviceManager.addAudioCallback (&audioSourcePlayer);
+       #endif
+
         setOpaque (true);
 
         addAndMakeVisible (header);
@@ -373,12 +688,21 @@ public:
     {
         signalThreadShouldExit();
         stop();
+
+       #ifndef JUCE_DEMO_RUNNER
+        // a driver that hangs while it's probed mustn't keep the app from quitting
+        deviceOpener.stopThread (4000);
+       #endif
+
         audioDeviceManager.removeAudioCallback (&audioSourcePlayer);
+        trackSwitcher.removeTransportListener (this);
         waitForThreadToExit (10000);
     }
 
     void paint (Graphics& g) override
     {
+        StartupTimer::mark (StartupTimer::firstPaint);
+
         g.setColour (getLookAndFeel().findColour (ResizableWindow::backgroundColourId));
         g.fillRect (getLocalBounds());
     }
@@ -393,40 +717,42 @@ public:
 
         if (parametersComponent != nullptr)
             parametersComponent->setBounds (r.removeFromTop (parametersComponent->getHeightNeeded()).reduced (20, 0));
-    }
 
-    //==============================================================================
-    bool loadURL (const URL& fileToPlay)
-    {
-        stop();
-
-        audioSourcePlayer.setSource (nullptr);
-        getThumbnailComponent().setTransportSource (nullptr);
-        transportSource.reset();
-        readerSource.reset();
+        r.removeFromTop (20);
 
-        auto source = makeInputSource (fileToPlay);
+        r = r.reduced (20, 0).withTrimmedBottom (20);
 
-        if (source == nullptr)
-            return false;
+        if (levelMeterComponent != nullptr)
+            levelMeterComponent->setBounds (r.removeFromRight (60));
 
-        auto stream = rawToUniquePtr (source->createInputStream());
+        r.removeFromRight (10);
 
-        if (stream == nullptr)
-            return false;
-
-        reader = rawToUniquePtr (formatManager.createReaderFor (std::move (stream)));
+        if (spectrumComponent != nullptr)
+            spectrumComponent->setBounds (r);
+    }
 
-        if (reader == nullptr)
-            return false;
+    //==============================================================================
+    /** Opens a file in the background. If something is playing, the new file takes over
+        from it without a gap once it is ready. onLoaded is called with the result.
+    */
+    void loadURL (const URL& fileToPlay, std::function<void (bool)> onLoaded = nullptr)
+    {
+        const auto wasPlaying = (bool) playState.getValue();
 
-        readerSource.reset (new AudioFormatReaderSource (reader.get(), false));
-        readerSource->setLooping (loopState.getValue());
+        trackSwitcher.loadAsync (fileToPlay, wasPlaying, [this, wasPlaying, onLoaded] (bool loaded)
+        {
+            if (loaded)
+            {
+                getThumbnailComponent().setPlaybackSource (&trackSwitcher);
+                analyseCurrentTrack();
 
-        init();
-        resized();
+                if (! wasPlaying)
+                    engine->requestReset();
+            }
 
-        return true;
+            if (onLoaded != nullptr)
+                onLoaded (loaded);
+        });
     }
 
     void togglePlay()
@@ -441,59 +767,66 @@ public:
     {
         playState = false;
 
-        if (transportSource.get() != nullptr)
+        if (auto* transportSource = trackSwitcher.getCurrentTransport())
         {
             transportSource->stop();
-            transportSource->setPosition (0);
+            trackSwitcher.setPosition (0);
         }
     }
 
+    /** Builds the playback chain and its parameter UI. This only happens once, later
+        calls to loadURL() reuse everything created here.
+    */
     void init()
     {
-        if (transportSource.get() == nullptr)
-        {
-            transportSource.reset (new AudioTransportSource());
-            transportSource->addChangeListener (this);
-            resampleSource.reset (new ResamplingAudioSource (transportSource.get(), false, 2));
+        jassert (engine == nullptr);
 
-            if (readerSource != nullptr)
-            {
-                if (auto* device = audioDeviceManager.getCurrentAudioDevice())
-                {
-                    transportSource->setSource (readerSource.get(), roundToInt (device->getCurrentSampleRate()), this, reader->sampleRate);
-
-                    getThumbnailComponent().setTransportSource (transportSource.get());
-                }
-            }
-        }
-
-        audioSourcePlayer.setSource (nullptr);
-        currentDemo.reset();
-
-        if (currentDemo.get() == nullptr)
-            currentDemo.reset (new DSPDemo<DemoType> (*transportSource, *resampleSource));
-
-        audioSourcePlayer.setSource (currentDemo.get());
+        trackSwitcher.addTransportListener (this);
+        trackSwitcher.onTrackChanged = [this]
+        {
+            getThumbnailComponent().setCurrentURL (trackSwitcher.getCurrentURL());
+            getThumbnailComponent().setPlaybackSource (&trackSwitcher);
+            analyseCurrentTrack();
+        };
+        engine = std::make_unique<PlaybackEngine> (trackSwitcher, &audioDeviceManager);
+        currentDemo.reset (new DSPDemo<DemoType> (*engine));
+        audioSourcePlayer.setSource (engine.get());
 
         auto& parameters = currentDemo->getParameters();
 
-        parametersComponent.reset();
-
         if (! parameters.empty())
         {
             parametersComponent = std::make_unique<DemoParametersComponent> (parameters);
             addAndMakeVisible (parametersComponent.get());
         }
+
+        spectrumComponent = std::make_unique<SpectrumComponent> (engine->getSpectrumAnalyser());
+        addAndMakeVisible (spectrumComponent.get());
+
+        levelMeterComponent = std::make_unique<LevelMeterComponent> (engine->getLevelMeter());
+        addAndMakeVisible (levelMeterComponent.get());
     }
 
     void play()
     {
-        if (readerSource == nullptr)
+        auto* transportSource = trackSwitcher.getCurrentTransport();
+
+        if (transportSource == nullptr)
             return;
 
-        if (transportSource->getCurrentPosition() >= transportSource->getLengthInSeconds()
-             || transportSource->getCurrentPosition() < 0)
-            transportSource->setPosition (0);
+        const auto position = trackSwitcher.getCurrentPosition();
+        const auto length = trackSwitcher.getLengthInSeconds();
+
+        // playing backwards from the start, or forwards from the end, begins at the other end
+        if (trackSwitcher.isReverse())
+        {
+            if (position <= 0)
+                trackSwitcher.setPosition (length);
+        }
+        else if (position >= length || position < 0)
+        {
+            trackSwitcher.setPosition (0);
+        }
 
         transportSource->start();
         playState = true;
@@ -501,8 +834,24 @@ public:
 
     void setLooping (bool shouldLoop)
     {
-        if (readerSource != nullptr)
-            readerSource->setLooping (shouldLoop);
+        trackSwitcher.setLooping (shouldLoop);
+    }
+
+    /** Sets the part of the current file to repeat, and turns looping on if it isn't empty. */
+    void setLoopRegion (Range<double> regionInSeconds)
+    {
+        trackSwitcher.setLoopRegion (regionInSeconds);
+
+        if (! regionInSeconds.isEmpty())
+            loopState = true;
+    }
+
+    /** Sets the files to play once the current one has finished. The first few of them
+        are opened and buffered in the background, so moving on to them is gapless.
+    */
+    void setQueue (const Array<URL>& urls)
+    {
+        trackSwitcher.setQueue (urls);
     }
 
     AudioThumbnailComponent& getThumbnailComponent()    { return header.thumbnailComp; }
@@ -514,10 +863,9 @@ private:
                                     private Value::Listener
     {
     public:
-        AudioPlayerHeader (AudioDeviceManager& adm,
-                           AudioFormatManager& afm,
+        AudioPlayerHeader (AudioFormatManager& afm,
                            AudioFileReaderComponent& afr)
-            : thumbnailComp (adm, afm),
+            : thumbnailComp (afm),
               audioFileReader (afr)
         {
             setOpaque (true);
@@ -537,6 +885,7 @@ private:
 
             addAndMakeVisible (thumbnailComp);
             thumbnailComp.addChangeListener (this);
+            thumbnailComp.onLoopRegionChanged = [this] (Range<double> region) { audioFileReader.setLoopRegion (region); };
 
             audioFileReader.playState.addListener (this);
             loopButton.getToggleStateValue().referTo (audioFileReader.loopState);
@@ -576,8 +925,6 @@ private:
         //==============================================================================
         void openFile()
         {
-            audioFileReader.stop();
-
             if (fileChooser != nullptr)
                 return;
 
@@ -595,25 +942,33 @@ private:
 
             fileChooser.reset (new FileChooser ("Select an audio file...", File(), "*.wav;*.mp3;*.aif"));
 
-            fileChooser->launchAsync (FileBrowserComponent::openMode | FileBrowserComponent::canSelectFiles,
+            fileChooser->launchAsync (FileBrowserComponent::openMode
+                                        | FileBrowserComponent::canSelectFiles
+                                        | FileBrowserComponent::canSelectMultipleItems,
                                       [this] (const FileChooser& fc) mutable
                                       {
-                                          if (fc.getURLResults().size() > 0)
+                                          auto results = fc.getURLResults();
+
+                                          if (results.size() > 0)
                                           {
-                                              const auto u = fc.getURLResult();
+                                              const auto u = results.removeAndReturn (0);
+                                              audioFileReader.setQueue (results);
 
-                                              if (! audioFileReader.loadURL (u))
+                                              audioFileReader.loadURL (u, [this, u] (bool loaded)
                                               {
-                                                  auto options = MessageBoxOptions().withIconType (MessageBoxIconType::WarningIcon)
-                                                                                    .withTitle ("Error loading file")
-                                                                                    .withMessage ("Unable to load audio file")
-                                                                                    .withButton ("OK");
-                                                  messageBox = NativeMessageBox::showScopedAsync (options, nullptr);
-                                              }
-                                              else
-                                              {
-                                                  thumbnailComp.setCurrentURL (u);
-                                              }
+                                                  if (! loaded)
+                                                  {
+                                                      auto options = MessageBoxOptions().withIconType (MessageBoxIconType::WarningIcon)
+                                                                                        .withTitle ("Error loading file")
+                                                                                        .withMessage ("Unable to load audio file")
+                                                                                        .withButton ("OK");
+                                                      messageBox = NativeMessageBox::showScopedAsync (options, nullptr);
+                                                  }
+                                                  else
+                                                  {
+                                                      thumbnailComp.setCurrentURL (u);
+                                                  }
+                                              });
                                           }
 
                                           fileChooser = nullptr;
@@ -622,10 +977,8 @@ private:
 
         void changeListenerCallback (ChangeBroadcaster*) override
         {
-            if (audioFileReader.playState.getValue())
-                audioFileReader.stop();
-
             audioFileReader.loadURL (thumbnailComp.getCurrentURL());
+            audioFileReader.setQueue (thumbnailComp.getDroppedQueue());
         }
 
         void valueChanged (Value& v) override
@@ -644,15 +997,34 @@ private:
     };
 
     //==============================================================================
+    // the read-ahead for every track runs on this thread
+    void run() override
+    {
+        RealtimeSetup::applyToCurrentThread (RealtimeSetup::diskThreads);
+        TimeSliceThread::run();
+    }
+
     void valueChanged (Value& v) override
     {
-        if (readerSource != nullptr)
-            readerSource->setLooping (v.getValue());
+        setLooping (v.getValue());
+    }
+
+    // the analysis can take a few seconds, by which time another file may be playing
+    void analyseCurrentTrack()
+    {
+        trackAnalyser.analyse (trackSwitcher.getCurrentURL(),
+                               [safeThis = SafePointer<AudioFileReaderComponent> (this)] (const URL& url, const TrackAnalysis& analysis)
+                               {
+                                   if (safeThis != nullptr && url == safeThis->trackSwitcher.getCurrentURL())
+                                       safeThis->currentDemo->setTrackAnalysis (analysis);
+                               });
     }
 
     void changeListenerCallback (ChangeBroadcaster*) override
     {
-        if (playState.getValue() && ! transportSource->isPlaying())
+        auto* transportSource = trackSwitcher.getCurrentTransport();
+
+        if (playState.getValue() && transportSource != nullptr && ! transportSource->isPlaying())
             stop();
     }
 
@@ -661,10 +1033,65 @@ private:
    #ifndef JUCE_DEMO_RUNNER
     AudioDeviceManager audioDeviceManager;
    #else
-    AudioDeviceManager& audioDeviceManager { getSharedAudioDeviceManager (0, 2) };
+    AudioDeviceManager& audioDeviceManager { getSharedAudioDeviceManager (0, TrackSwitcher::maxNumChannels) };
+   #endif
+
+   #ifndef JUCE_DEMO_RUNNER
+    /** Probes the audio devices on its own thread, then has the message thread open one.
+
+        The slow part of opening a device is the first scan, where the drivers enumerate
+        their hardware. That scan is done here with device types of the thread's own, which
+        are thrown away again; by the time the message thread opens the device the drivers
+        have done their work. The manager itself is only ever touched on the message thread.
+    */
+    struct DeviceOpener final : public juce::Thread
+    {
+        explicit DeviceOpener (AudioFileReaderComponent& o)
+            : juce::Thread ("Audio Device Opener"), owner (o) {}
+
+        void run() override
+        {
+            {
+                // createAudioDeviceTypes() only fills the array, it doesn't touch the manager
+                OwnedArray<AudioIODeviceType> types;
+                owner.audioDeviceManager.createAudioDeviceTypes (types);
+
+                for (auto* type : types)
+                {
+                    if (threadShouldExit())
+                        return;
+
+                    type->scanForDevices();
+                }
+            }
+
+            MessageManager::callAsync ([safeOwner = Component::SafePointer<AudioFileReaderComponent> (&owner)]
+            {
+                if (safeOwner != nullptr)
+                    safeOwner->openDevice();
+            });
+        }
+
+        AudioFileReaderComponent& owner;
+    };
+
+    DeviceOpener deviceOpener { *this };
+
+    void openDevice()
+    {
+        // asks for as many outputs as a file can have, the device opens what it's got
+        const auto error = audioDeviceManager.initialiseWithDefaultDevices (0, TrackSwitcher::maxNumChannels);
+
+        if (error.isNotEmpty())
+            Logger::writeToLog ("Couldn't open the audio device: " + error);
+
+        audioDeviceManager.addAudioCallback (&audioSourcePlayer);
+        StartupTimer::mark (StartupTimer::deviceOpened);
+    }
    #endif
 
     AudioFormatManager formatManager;
+    TrackAnalyser trackAnalyser { formatManager };
     Value playState { var (false) };
     Value loopState { var (false) };
 
@@ -672,10 +1099,8 @@ private:
     uint32 currentBlockSize = 512;
     uint32 currentNumChannels = 2;
 
-    std::unique_ptr<AudioFormatReader> reader;
-    std::unique_ptr<AudioFormatReaderSource> readerSource;
-    std::unique_ptr<AudioTransportSource> transportSource;
-    std::unique_ptr<juce::ResamplingAudioSource> resampleSource;
+    TrackSwitcher trackSwitcher { formatManager, *this };
+    std::unique_ptr<PlaybackEngine> engine;
     std::unique_ptr<DSPDemo<DemoType>> currentDemo;
 
     AudioSourcePlayer audioSourcePlayer;
@@ -685,4 +1110,6 @@ private:
     AudioBuffer<float> fileReadBuffer;
 
     std::unique_ptr<DemoParametersComponent> parametersComponent;
+    std::unique_ptr<SpectrumComponent> spectrumComponent;
+    std::unique_ptr<LevelMeterComponent> levelMeterComponent;
 };
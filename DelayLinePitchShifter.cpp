@@ -0,0 +1,365 @@
+#include "DelayLinePitchShifter.h"
+#include "InterpolationTables.h"
+
+DelayLinePitchShifter::DelayLinePitchShifter (int lineSize, int overlapSize)
+    : size (nextPowerOfTwo (lineSize)),
+      mask (size - 1),
+      configurations (makeConfigurations (size, jlimit (1, size / 2, overlapSize)))
+{
+}
+
+DelayLinePitchShifter::Configurations DelayLinePitchShifter::makeConfigurations (int lineSize, int overlapSize) noexcept
+{
+    // Each window is half the next. The speeds keep the handovers to somewhere between 10 and
+    // 20 a second: a quarter of the line up to two semitones up, half of it up to six, then
+    // all of it.
+    return { { { lineSize / 4, jmin (overlapSize / 2, lineSize / 8), 0.125f },
+               { lineSize / 2, jmin (overlapSize, lineSize / 4),     0.42f },
+               { lineSize,     overlapSize,                          std::numeric_limits<float>::max() } } };
+}
+
+size_t DelayLinePitchShifter::getRequiredBytes (const dsp::ProcessSpec& spec) const noexcept
+{
+    return getNumGroups (spec.numChannels) * DspArena::getAlignedSize<Vec> ((size_t) size)
+            + DspArena::getAlignedSize<HeadControl> (spec.maximumBlockSize);
+}
+
+void DelayLinePitchShifter::prepare (const dsp::ProcessSpec& spec, DspArena& arena)
+{
+    numChannels = spec.numChannels;
+    lines.resize (getNumGroups (numChannels));
+
+    for (auto& line : lines)
+        line = arena.allocate<Vec> ((size_t) size);
+
+    maxBlockSize = (int) spec.maximumBlockSize;
+    controls = arena.allocate<HeadControl> (spec.maximumBlockSize);
+
+    kernels = { chooseKernels<4> (numChannels, maxBlockSize), chooseKernels<2> (numChannels, maxBlockSize) };
+    genericKernels = { getGenericKernels<4>(), getGenericKernels<2>() };
+
+    reset();
+}
+
+void DelayLinePitchShifter::reset() noexcept
+{
+    for (auto* line : lines)
+        std::fill (line, line + size, Vec::expand (0.0f));
+
+    writePosition = 0;
+
+    // nothing's playing, so the window can change straight away
+    configuration = targetConfiguration;
+    currentConfiguration = configuration;
+
+    // one head sits in the middle of the line and the other is faded out at the start of
+    // the window, so with no shift the output is exactly half a line late
+    phase = (float) configurations[(size_t) configuration].window * 0.5f;
+}
+
+void DelayLinePitchShifter::setShiftSemitones (float semitones) noexcept
+{
+    // the heads' delay shrinks by (ratio - 1) samples for every sample written
+    phaseIncrement = 1.0f - std::pow (2.0f, semitones / 12.0f);
+    targetConfiguration = getConfigurationFor (semitones);
+}
+
+int DelayLinePitchShifter::getConfigurationFor (float semitones) const noexcept
+{
+    const auto speed = std::abs (1.0f - std::pow (2.0f, semitones / 12.0f));
+
+    for (int i = 0; i < numConfigurations - 1; ++i)
+        if (speed <= configurations[(size_t) i].maxSpeed)
+            return i;
+
+    return numConfigurations - 1;
+}
+
+String DelayLinePitchShifter::getConfigurationReport (int highlighted) const
+{
+    String report;
+    report << "delay line of " << (int) (size * sizeof (Vec) / 1024) << " KB for every " << (int) lanes << " channels";
+
+    for (int i = 0; i < numConfigurations; ++i)
+    {
+        const auto& c = configurations[(size_t) i];
+        const auto cost = nanosecondsPerSample[(size_t) i].load (std::memory_order_relaxed);
+
+        report << newLine << (i == highlighted ? "  * " : "    ")
+               << "window " << c.window << ", crossfade " << c.overlap
+               << ": reads span " << (int) (c.window * sizeof (Vec) / 1024) << " KB, "
+               << (cost > 0.0 ? String (cost, 1) + " ns per sample" : String ("not run yet"))
+               << (i == currentConfiguration.load() ? " (in use)" : "");
+    }
+
+    return report;
+}
+
+float DelayLinePitchShifter::getHeadGain (float position, float window, float overlap) noexcept
+{
+    return jmin (1.0f, position / overlap, (window - position) / overlap);
+}
+
+void DelayLinePitchShifter::process (const dsp::ProcessContextReplacing<float>& context, ChannelGroupPool* pool) noexcept
+{
+    const auto& block = context.getOutputBlock();
+    const auto numGroups = (int) getNumGroups (jmin (block.getNumChannels(), numChannels));
+
+    if (numGroups == 0 || block.getNumSamples() == 0)
+        return;
+
+    // the controls only have room for a block of the prepared size
+    if ((int) block.getNumSamples() > maxBlockSize)
+    {
+        for (size_t done = 0; done < block.getNumSamples(); done += (size_t) maxBlockSize)
+        {
+            auto part = block.getSubBlock (done, jmin ((size_t) maxBlockSize, block.getNumSamples() - done));
+            process (dsp::ProcessContextReplacing<float> (part), pool);
+        }
+
+        return;
+    }
+
+    // The weights move towards the interpolation that's been asked for by at most a block's
+    // share of the fade. Only a block that's part of the fade needs the blended weights.
+    const auto numSamples = (int) block.getNumSamples();
+    const auto target = interpolation == Interpolation::lagrange3 ? 1.0f : 0.0f;
+    const auto maxChange = (float) numSamples / (float) interpolationFadeLength;
+    const auto change = jlimit (-maxChange, maxChange, target - lagrange);
+
+    lagrangeStep = change / (float) numSamples;
+
+    const auto startTicks = Time::getHighResolutionTicks();
+    const HeadState start { writePosition, phase, configuration };
+    auto end = start;
+
+    if (! exactlyEqual (lagrange, target))
+        end = computeControls<Weights::blended> (start, numSamples);
+    else if (interpolation == Interpolation::linear)
+        end = computeControls<Weights::linear> (start, numSamples);
+    else
+        end = computeControls<Weights::lagrange3> (start, numSamples);
+
+    // the specialised kernels only fit a block of the size and width they were picked for
+    const auto twoTaps = interpolation == Interpolation::linear && exactlyEqual (lagrange, 0.0f);
+    const auto& groupKernels = (numSamples == maxBlockSize && block.getNumChannels() >= numChannels)
+                                 ? kernels[twoTaps ? 1 : 0] : genericKernels[twoTaps ? 1 : 0];
+
+    // every group reads the same controls, so they can go in any order
+    const auto runGroup = [&] (int group)
+    {
+        const auto kernel = group == numGroups - 1 ? groupKernels.lastGroup : groupKernels.fullGroup;
+        (this->*kernel) (block, (size_t) group, start.writePosition);
+    };
+
+    if (pool != nullptr && numGroups > 1)
+        pool->run (numGroups, [&] (int group) { runGroup (group); });
+    else
+        for (int group = 0; group < numGroups; ++group)
+            runGroup (group);
+
+    writePosition = end.writePosition;
+    phase = end.phase;
+    configuration = end.configuration;
+    currentConfiguration = configuration;
+
+    const auto nanoseconds = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - startTicks) * 1.0e9 / numSamples;
+    auto& cost = nanosecondsPerSample[(size_t) start.configuration];
+    const auto previousCost = cost.load (std::memory_order_relaxed);
+    cost.store (previousCost > 0.0 ? previousCost + (nanoseconds - previousCost) * 0.01 : nanoseconds, std::memory_order_relaxed);
+
+    lagrange = std::abs (target - (lagrange + change)) < 1.0e-4f ? target : lagrange + change;
+}
+
+//==============================================================================
+template <DelayLinePitchShifter::Weights W>
+DelayLinePitchShifter::HeadState DelayLinePitchShifter::computeControls (HeadState state, int numSamples) noexcept
+{
+    const auto fSize = (float) size;
+
+    const auto* config = &configurations[(size_t) state.configuration];
+    auto window = (float) config->window;
+    auto halfWindow = window * 0.5f;
+    auto offset = (fSize - window) * 0.5f;
+    auto overlap = (float) config->overlap;
+
+    for (int i = 0; i < numSamples; ++i)
+    {
+        // the heads read relative to the sample that's about to be written
+        state.writePosition = (state.writePosition + 1) & mask;
+
+        const auto phaseB = state.phase >= halfWindow ? state.phase - halfWindow : state.phase + halfWindow;
+        const auto gainA = getHeadGain (state.phase, window, overlap);
+        const auto gainB = getHeadGain (phaseB, window, overlap);
+        const auto norm = 1.0f / (gainA + gainB);
+
+        const auto lagrangeAmount = lagrange + lagrangeStep * (float) i;
+        const auto writePos = (float) state.writePosition;
+        auto& control = controls[i];
+
+        computeWeights<W> (writePos - (offset + state.phase), lagrangeAmount, gainA * norm, control.indexA, control.weightsA);
+        computeWeights<W> (writePos - (offset + phaseB), lagrangeAmount, gainB * norm, control.indexB, control.weightsB);
+
+        const auto previousPhase = state.phase;
+        state.phase += phaseIncrement;
+
+        const auto wrapped = state.phase >= window || state.phase < 0.0f;
+
+        if (state.phase >= window)
+            state.phase -= window;
+        else if (state.phase < 0.0f)
+            state.phase += window;
+
+        // A new window takes over when one of the heads passes the middle of the old one,
+        // where the other head is silent. The head in the middle keeps its delay, and the
+        // silent one starts again from the edge of the new window.
+        if (state.configuration != targetConfiguration
+             && (wrapped || (previousPhase - halfWindow) * (state.phase - halfWindow) <= 0.0f))
+        {
+            // how far head A is past the edge when B is in the middle, or past the middle
+            const auto fromPoint = wrapped ? (state.phase < halfWindow ? state.phase : state.phase - window)
+                                           : state.phase - halfWindow;
+
+            state.configuration = targetConfiguration;
+            config = &configurations[(size_t) state.configuration];
+            window = (float) config->window;
+            halfWindow = window * 0.5f;
+            offset = (fSize - window) * 0.5f;
+            overlap = (float) config->overlap;
+
+            state.phase = wrapped ? (fromPoint < 0.0f ? window + fromPoint : fromPoint)
+                                  : halfWindow + fromPoint;
+        }
+    }
+
+    return state;
+}
+
+template <DelayLinePitchShifter::Weights W>
+void DelayLinePitchShifter::computeWeights (float position, float lagrangeAmount, float gain, int& index, float* weights) noexcept
+{
+    const auto base = (int) std::floor (position);
+    const auto t = position - (float) base;
+    index = base;
+
+    if constexpr (W == Weights::linear)
+    {
+        ignoreUnused (lagrangeAmount);
+
+        weights[0] = 0.0f;
+        weights[1] = gain * (1.0f - t);
+        weights[2] = gain * t;
+        weights[3] = 0.0f;
+    }
+    else
+    {
+        // 3rd-order Lagrange through the four samples around the read position
+        float lagrangeWeights[4];
+
+       #if PLAYER_ENGINE_INTERPOLATION_TABLES
+        InterpolationTables::lagrange3Table.lookup (t, lagrangeWeights);
+       #else
+        InterpolationTables::lagrange3Weights (t, lagrangeWeights);
+       #endif
+
+        auto w0 = lagrangeWeights[0], w1 = lagrangeWeights[1], w2 = lagrangeWeights[2], w3 = lagrangeWeights[3];
+
+        if constexpr (W == Weights::blended)
+        {
+            // part of the way from linear between the middle two samples to Lagrange
+            w0 *= lagrangeAmount;
+            w1 = (1.0f - t) + lagrangeAmount * (w1 - (1.0f - t));
+            w2 = t + lagrangeAmount * (w2 - t);
+            w3 *= lagrangeAmount;
+        }
+        else
+        {
+            ignoreUnused (lagrangeAmount);
+        }
+
+        weights[0] = gain * w0;
+        weights[1] = gain * w1;
+        weights[2] = gain * w2;
+        weights[3] = gain * w3;
+    }
+}
+
+template <int BlockSize, int Taps>
+DelayLinePitchShifter::GroupKernel DelayLinePitchShifter::chooseKernel (size_t groupChannels) noexcept
+{
+    // a full group, and mono and stereo for the last one, cover the layouts we actually play
+    if (groupChannels == lanes)
+        return &DelayLinePitchShifter::processGroup<lanes, BlockSize, Taps>;
+
+    if (groupChannels == 1)
+        return &DelayLinePitchShifter::processGroup<1, BlockSize, Taps>;
+
+    if (groupChannels == 2)
+        return &DelayLinePitchShifter::processGroup<2, BlockSize, Taps>;
+
+    return &DelayLinePitchShifter::processGroup<0, BlockSize, Taps>;
+}
+
+template <int Taps>
+DelayLinePitchShifter::GroupKernels DelayLinePitchShifter::chooseKernels (size_t numChannels, int blockSize) noexcept
+{
+    const auto lastGroupChannels = numChannels - (getNumGroups (numChannels) - 1) * lanes;
+
+    // the engine always prepares the shifter for its internal block of 256 samples
+    if (blockSize == 256)
+        return { chooseKernel<256, Taps> (lanes), chooseKernel<256, Taps> (lastGroupChannels) };
+
+    return { chooseKernel<0, Taps> (lanes), chooseKernel<0, Taps> (lastGroupChannels) };
+}
+
+template <size_t GroupChannels, int BlockSize, int Taps>
+void DelayLinePitchShifter::processGroup (const dsp::AudioBlock<float>& block, size_t group, int startWritePosition) const noexcept
+{
+    const auto numSamples = BlockSize != 0 ? BlockSize : (int) block.getNumSamples();
+    const auto firstChannel = group * lanes;
+    const auto groupChannels = GroupChannels != 0 ? GroupChannels
+                                                  : jmin (lanes, jmin (block.getNumChannels(), numChannels) - firstChannel);
+
+    jassert (numSamples == (int) block.getNumSamples());
+
+    alignas (Vec::SIMDRegisterSize) float frame[lanes] = {};
+    float* channels[lanes] = {};
+
+    for (size_t lane = 0; lane < groupChannels; ++lane)
+        channels[lane] = block.getChannelPointer (firstChannel + lane);
+
+    auto* line = lines[group];
+    auto writePos = startWritePosition;
+
+    for (int i = 0; i < numSamples; ++i)
+    {
+        for (size_t lane = 0; lane < groupChannels; ++lane)
+            frame[lane] = channels[lane][i];
+
+        writePos = (writePos + 1) & mask;
+        line[writePos] = Vec::fromRawArray (frame);
+
+        const auto& control = controls[i];
+        const auto a = control.indexA, b = control.indexB;
+        const auto* wa = control.weightsA;
+        const auto* wb = control.weightsB;
+
+        Vec out;
+
+        if constexpr (Taps == 2)
+        {
+            out = line[a & mask] * wa[1] + line[(a + 1) & mask] * wa[2]
+                + line[b & mask] * wb[1] + line[(b + 1) & mask] * wb[2];
+        }
+        else
+        {
+            out = line[(a - 1) & mask] * wa[0] + line[a & mask] * wa[1] + line[(a + 1) & mask] * wa[2] + line[(a + 2) & mask] * wa[3]
+                + line[(b - 1) & mask] * wb[0] + line[b & mask] * wb[1] + line[(b + 1) & mask] * wb[2] + line[(b + 2) & mask] * wb[3];
+        }
+
+        out.copyToRawArray (frame);
+
+        for (size_t lane = 0; lane < groupChannels; ++lane)
+            channels[lane][i] = frame[lane];
+    }
+}
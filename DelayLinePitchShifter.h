@@ -0,0 +1,178 @@
+#pragma once
+
+#include "EngineModules.h"
+#include "DspArena.h"
+#include "ChannelGroupPool.h"
+
+/** A delay-line pitch shifter with two crossfaded read heads, like chowdsp::PitchShifter,
+    whose state lives in a DspArena instead of its own allocations.
+
+    Each channel writes into a circular delay line of `size` samples. Two read heads,
+    half a line apart, move through it at a rate set by the pitch ratio; as a head gets
+    close to the write position or to the end of the line it fades out over `overlap`
+    samples and the other one takes over. The heads are read with 3rd-order Lagrange
+    interpolation, its weights taken from a table built at compile time, or with linear
+    interpolation when CPU is short, at about half the cost.
+    On average the output is half a delay line behind the input.
+
+    How much of the line the heads sweep depends on the shift. A small shift moves them
+    slowly, so a short window still hands over rarely, and keeps the two heads close together
+    while they overlap; a large one needs the whole line to keep the handovers down. Every
+    window is centred on the middle of the line, so the latency stays the same, and a new
+    window takes over when one head passes that middle, where the other one is silent.
+
+    All channels share the same heads. Their positions, gains and interpolation weights
+    are worked out once per sample for the whole block, then applied to the channels in
+    groups, one per lane of a SIMDRegister, so every channel reads from exactly the same
+    places and the image stays phase-coherent. Eight channels cost about twice as much as
+    stereo rather than four times. The groups are independent of each other, so with a
+    ChannelGroupPool they can also run on several threads at once.
+*/
+class DelayLinePitchShifter final
+{
+public:
+    /** size is the length of the line and overlap the crossfade of the largest window. */
+    DelayLinePitchShifter (int size, int overlap);
+
+    /** Returns the arena space needed for the given spec. */
+    size_t getRequiredBytes (const dsp::ProcessSpec& spec) const noexcept;
+
+    /** Takes the delay lines out of the arena, which must have room for getRequiredBytes(). */
+    void prepare (const dsp::ProcessSpec& spec, DspArena& arena);
+    void reset() noexcept;
+
+    void setShiftSemitones (float semitones) noexcept;
+
+    enum class Interpolation
+    {
+        lagrange3,
+        linear
+    };
+
+    /** Changes how the heads are read. The weights are blended from one to the other over
+        a few milliseconds, so the change doesn't click. Called on the audio thread.
+    */
+    void setInterpolation (Interpolation newInterpolation) noexcept     { interpolation = newInterpolation; }
+
+    int getLatencySamples() const noexcept      { return size / 2; }
+
+    /** Returns the index of the window that's used for a shift. */
+    int getConfigurationFor (float semitones) const noexcept;
+
+    /** Describes each window, with the memory its reads span and what it has cost so far.
+        Can be called from any thread.
+    */
+    String getConfigurationReport (int highlighted) const;
+
+    /** Processes the block, spreading the channel groups over the pool if there is one. */
+    void process (const dsp::ProcessContextReplacing<float>& context, ChannelGroupPool* pool = nullptr) noexcept;
+
+private:
+    using Vec = dsp::SIMDRegister<float>;
+    static constexpr size_t lanes = Vec::SIMDNumElements;
+
+    static size_t getNumGroups (size_t numChannels) noexcept    { return (numChannels + lanes - 1) / lanes; }
+
+    struct HeadState
+    {
+        int writePosition;
+        float phase;
+        int configuration;
+    };
+
+    struct Configuration
+    {
+        int window, overlap;
+
+        // the fastest the heads can move through the line, |ratio - 1|, to use this window
+        float maxSpeed;
+    };
+
+    static constexpr int numConfigurations = 3;
+    using Configurations = std::array<Configuration, numConfigurations>;
+
+    static Configurations makeConfigurations (int size, int overlap) noexcept;
+
+    // where both heads read from for one sample, with their gains folded into the weights
+    struct HeadControl
+    {
+        int indexA, indexB;
+        float weightsA[4], weightsB[4];
+    };
+
+    // what the heads are read with: one of the two kinds of interpolation, or a blend that
+    // moves between them over a block, which costs a bit more than either
+    enum class Weights
+    {
+        lagrange3,
+        linear,
+        blended
+    };
+
+    /** Moves the heads through a block and fills in the controls for every sample of it. */
+    template <Weights W>
+    HeadState computeControls (HeadState start, int numSamples) noexcept;
+
+    template <Weights W>
+    static void computeWeights (float position, float lagrangeAmount, float gain, int& index, float* weights) noexcept;
+
+    /** Writes one group of channels into its line and reads it back through the controls.
+        The loops are compiled for a fixed number of channels in the group and samples in
+        the block; 0 in either works it out from the block instead. Linear interpolation
+        only needs the middle two of the four taps.
+    */
+    template <size_t GroupChannels, int BlockSize, int Taps>
+    void processGroup (const dsp::AudioBlock<float>& block, size_t group, int startWritePosition) const noexcept;
+
+    using GroupKernel = void (DelayLinePitchShifter::*) (const dsp::AudioBlock<float>&, size_t, int) const noexcept;
+
+    struct GroupKernels
+    {
+        GroupKernel fullGroup, lastGroup;
+    };
+
+    template <int Taps>
+    static GroupKernels chooseKernels (size_t numChannels, int blockSize) noexcept;
+
+    template <int BlockSize, int Taps>
+    static GroupKernel chooseKernel (size_t groupChannels) noexcept;
+
+    // these work out both the length of the block and the width of every group from the
+    // block itself, so they fit any block
+    template <int Taps>
+    static GroupKernels getGenericKernels() noexcept
+    {
+        return { &DelayLinePitchShifter::processGroup<0, 0, Taps>, &DelayLinePitchShifter::processGroup<0, 0, Taps> };
+    }
+
+    static float getHeadGain (float position, float window, float overlap) noexcept;
+
+    const int size, mask;
+    const Configurations configurations;
+
+    // one delay line per group of channels, each entry holds a sample of every channel in it
+    std::vector<Vec*> lines;
+    HeadControl* controls = nullptr;
+    int maxBlockSize = 0;
+    size_t numChannels = 0;
+    int writePosition = 0;
+    float phase = 0.0f, phaseIncrement = 0.0f;
+    int configuration = numConfigurations - 1, targetConfiguration = numConfigurations - 1;
+
+    // for the report: the window in use, and an average of each one's cost per sample
+    std::atomic<int> currentConfiguration { numConfigurations - 1 };
+    std::array<std::atomic<double>, numConfigurations> nanosecondsPerSample {};
+
+    // picked in prepare() for four taps and for two, the generic ones are for a block that
+    // doesn't match the spec, in length or in width
+    std::array<GroupKernels, 2> kernels {}, genericKernels {};
+
+    static constexpr int interpolationFadeLength = 512;
+
+    // how far the weights are from linear towards Lagrange, and how much that changes per
+    // sample over the current block
+    Interpolation interpolation = Interpolation::lagrange3;
+    float lagrange = 1.0f, lagrangeStep = 0.0f;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (DelayLinePitchShifter)
+};
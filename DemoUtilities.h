@@ -25,6 +25,7 @@
 #define PIP_DEMO_UTILITIES_INCLUDED 1
 
 #include <JuceHeader.h>
+#include "InputSources.h"
 
 //==============================================================================
 /*
@@ -263,19 +264,6 @@ struct SlowerBouncingNumber final : public BouncingNumber
     }
 };
 
-inline std::unique_ptr<InputSource> makeInputSource (const URL& url)
-{
-    if (const auto doc = AndroidDocument::fromDocument (url))
-        return std::make_unique<AndroidDocumentInputSource> (doc);
-
-   #if ! JUCE_IOS
-    if (url.isLocalFile())
-        return std::make_unique<FileInputSource> (url.getLocalFile());
-   #endif
-
-    return std::make_unique<URLInputSource> (url);
-}
-
 inline std::unique_ptr<OutputStream> makeOutputStream (const URL& url)
 {
     if (const auto doc = AndroidDocument::fromDocument (url))
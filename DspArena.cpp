@@ -0,0 +1,114 @@
+#include "DspArena.h"
+
+#if JUCE_LINUX || JUCE_BSD || JUCE_MAC
+ #include <sys/mman.h>
+#elif JUCE_WINDOWS
+ #include <windows.h>
+#endif
+
+DspArena::~DspArena()
+{
+    release();
+}
+
+void DspArena::reserve (size_t numBytes, int options)
+{
+    numBytes = getAlignedSize (jmax ((size_t) 1, numBytes));
+
+    if (numBytes <= capacity && options == currentOptions)
+    {
+        used = 0;
+        std::memset (data, 0, capacity);
+        return;
+    }
+
+    release();
+    currentOptions = options;
+
+   #if JUCE_LINUX || JUCE_BSD || JUCE_MAC
+    {
+        // huge pages come in 2 MB steps on the platforms that have them
+        constexpr size_t hugePageSize = 2 * 1024 * 1024;
+
+       #if JUCE_LINUX && defined (MAP_HUGETLB)
+        if ((options & hugePages) != 0)
+        {
+            const auto size = (numBytes + hugePageSize - 1) / hugePageSize * hugePageSize;
+            auto* mapped = mmap (nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+            if (mapped != MAP_FAILED)
+            {
+                data = static_cast<char*> (mapped);
+                mappedSize = size;
+                onHugePages = true;
+            }
+        }
+       #endif
+
+        if (data == nullptr)
+        {
+            auto* mapped = mmap (nullptr, numBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+            if (mapped != MAP_FAILED)
+            {
+                data = static_cast<char*> (mapped);
+                mappedSize = numBytes;
+
+               #if JUCE_LINUX && defined (MADV_HUGEPAGE)
+                // without reserved huge pages, transparent ones are the next best thing
+                if ((options & hugePages) != 0 && numBytes >= hugePageSize)
+                    madvise (mapped, numBytes, MADV_HUGEPAGE);
+               #endif
+            }
+        }
+
+        if (data != nullptr && (options & lockInMemory) != 0)
+            locked = mlock (data, mappedSize) == 0;
+    }
+   #elif JUCE_WINDOWS
+    if (auto* mapped = VirtualAlloc (nullptr, numBytes, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE))
+    {
+        data = static_cast<char*> (mapped);
+        mappedSize = numBytes;
+
+        if ((options & lockInMemory) != 0)
+            locked = VirtualLock (mapped, numBytes) != 0;
+    }
+   #endif
+
+    if (data == nullptr)
+    {
+        fallback.calloc (numBytes + alignment);
+        data = snapPointerToAlignment (fallback.get(), alignment);
+    }
+
+    capacity = numBytes;
+    used = 0;
+
+    // touch every page now rather than on the audio thread
+    std::memset (data, 0, capacity);
+}
+
+void DspArena::release() noexcept
+{
+    if (mappedSize > 0)
+    {
+       #if JUCE_LINUX || JUCE_BSD || JUCE_MAC
+        if (locked)
+            munlock (data, mappedSize);
+
+        munmap (data, mappedSize);
+       #elif JUCE_WINDOWS
+        if (locked)
+            VirtualUnlock (data, mappedSize);
+
+        VirtualFree (data, 0, MEM_RELEASE);
+       #endif
+    }
+
+    fallback.free();
+
+    data = nullptr;
+    capacity = used = mappedSize = 0;
+    onHugePages = locked = false;
+}
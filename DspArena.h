@@ -0,0 +1,83 @@
+#pragma once
+
+#include "EngineModules.h"
+
+/** One contiguous block of memory that a processing chain carves all of its state from.
+
+    The chain works out how many bytes it needs, reserves them in one go and then takes
+    its pieces in the order it processes them, so a block touches a few neighbouring
+    pages instead of allocations scattered over the heap. Every piece starts on a cache
+    line. The memory can be asked to sit on huge pages and to be locked into RAM; both
+    are best effort and can be checked afterwards.
+
+    Everything carved out of the arena is invalidated by the next reserve().
+*/
+class DspArena final
+{
+public:
+    enum Options
+    {
+        none          = 0,
+        hugePages     = 1 << 0,
+        lockInMemory  = 1 << 1
+    };
+
+    static constexpr size_t alignment = 64;
+
+    DspArena() = default;
+    ~DspArena();
+
+    /** Returns the room a piece of numBytes takes up, including its alignment. */
+    static constexpr size_t getAlignedSize (size_t numBytes) noexcept
+    {
+        return (numBytes + alignment - 1) / alignment * alignment;
+    }
+
+    template <typename Type>
+    static constexpr size_t getAlignedSize (size_t count) noexcept
+    {
+        return getAlignedSize (count * sizeof (Type));
+    }
+
+    /** Makes sure there are at least numBytes to carve from and starts carving again from
+        the beginning. The memory is only reallocated when it has to grow, or when the
+        options change.
+    */
+    void reserve (size_t numBytes, int options = none);
+
+    /** Takes the next count objects out of the arena, zeroed and cache-line aligned. */
+    template <typename Type>
+    Type* allocate (size_t count) noexcept
+    {
+        static_assert (std::is_trivially_copyable_v<Type>, "The arena never runs constructors or destructors");
+
+        const auto size = getAlignedSize<Type> (count);
+
+        if (used + size > capacity)
+        {
+            jassertfalse; // the chain asked for more than it reserved
+            return nullptr;
+        }
+
+        auto* piece = data + used;
+        used += size;
+        return reinterpret_cast<Type*> (piece);
+    }
+
+    size_t getCapacity() const noexcept         { return capacity; }
+    size_t getBytesUsed() const noexcept        { return used; }
+    bool isOnHugePages() const noexcept         { return onHugePages; }
+    bool isLockedInMemory() const noexcept      { return locked; }
+
+private:
+    void release() noexcept;
+
+    char* data = nullptr;
+    size_t capacity = 0, used = 0, mappedSize = 0;
+    int currentOptions = none;
+    bool onHugePages = false, locked = false;
+
+    HeapBlock<char> fallback;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (DspArena)
+};
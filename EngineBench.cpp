@@ -0,0 +1,244 @@
+#include "EngineModules.h"
+#include "InterpolationTables.h"
+#include "DelayLinePitchShifter.h"
+#include "LevelMeter.h"
+
+#include <cstdio>
+
+/*  Times the engine's hot paths on their own, without a device or a GUI, so the figures
+    the changes to them were made on can be measured again:
+
+        PlayerEngineBench
+
+    Every figure is the best of a number of runs, as the fastest run is the one that was
+    disturbed least by the rest of the machine. The pitch shifter is timed the way the
+    library was built; configure with -DPLAYER_ENGINE_INTERPOLATION_TABLES=ON and run it
+    again to see it with the table instead of the polynomial.
+*/
+
+template <typename Function>
+static double getBestSeconds (int numRuns, Function&& function)
+{
+    auto best = std::numeric_limits<double>::max();
+
+    for (int run = 0; run < numRuns; ++run)
+    {
+        const auto start = Time::getHighResolutionTicks();
+        function();
+        best = jmin (best, Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - start));
+    }
+
+    return best;
+}
+
+// keeps the optimiser from dropping work whose result isn't otherwise used
+static volatile float sink = 0.0f;
+
+//==============================================================================
+static constexpr int numPositions = 4096;
+
+static std::vector<float> makePositions()
+{
+    Random random (1);
+    std::vector<float> positions (numPositions);
+
+    for (auto& t : positions)
+        t = random.nextFloat();
+
+    return positions;
+}
+
+template <typename Weights>
+static double getNanosecondsPerPosition (const std::vector<float>& positions, Weights&& weightsAt)
+{
+    const auto seconds = getBestSeconds (50, [&]
+    {
+        auto sum = 0.0f;
+
+        for (auto t : positions)
+        {
+            float weights[4];
+            weightsAt (t, weights);
+            sum += weights[0] - weights[1] + weights[2] - weights[3];
+        }
+
+        sink = sum;
+    });
+
+    return seconds * 1.0e9 / numPositions;
+}
+
+struct TableResult
+{
+    int steps;
+    double worstError, nanoseconds;
+};
+
+template <int Steps>
+static TableResult measureTable (const std::vector<float>& positions)
+{
+    static const InterpolationTables::WeightTable<Steps> table { InterpolationTables::lagrange3 };
+
+    // against the exact weights, at many more points than the table has
+    auto worstError = 0.0;
+
+    for (int i = 0; i <= 1 << 16; ++i)
+    {
+        const auto t = (double) i / (1 << 16);
+        const auto exact = InterpolationTables::lagrange3 (t);
+
+        float weights[4];
+        table.lookup ((float) t, weights);
+
+        for (int k = 0; k < 4; ++k)
+            worstError = jmax (worstError, std::abs ((double) weights[k] - (double) exact.w[k]));
+    }
+
+    return { Steps, worstError, getNanosecondsPerPosition (positions, [] (float t, float* w) { table.lookup (t, w); }) };
+}
+
+template <int... Steps>
+static std::vector<TableResult> measureTables (const std::vector<float>& positions)
+{
+    return { measureTable<Steps> (positions)... };
+}
+
+static double toDecibels (double error)
+{
+    return -20.0 * std::log10 (jmax (error, 1.0e-12));
+}
+
+static void benchInterpolation()
+{
+    const auto positions = makePositions();
+
+    std::printf ("3rd-order Lagrange weights, per read position\n\n");
+
+    const auto polynomial = getNanosecondsPerPosition (positions, [] (float t, float* w) { InterpolationTables::lagrange3Weights (t, w); });
+    std::printf ("  polynomial               %6.2f ns\n\n", polynomial);
+
+    const auto results = measureTables<16, 32, 64, 128, 256, 512, 1024> (positions);
+
+    std::printf ("  steps      bytes   worst error      SNR      time\n");
+
+    for (const auto& r : results)
+        std::printf ("  %5d   %8d   %11.3g  %5.1f dB  %5.2f ns\n", r.steps,
+                     (int) ((size_t) (r.steps + 1) * sizeof (InterpolationTables::FourWeights)),
+                     r.worstError, toDecibels (r.worstError), r.nanoseconds);
+
+    std::printf ("\n  target SNR   steps   measured SNR\n");
+
+    for (const auto target : { 48, 72, 96, 120 })
+    {
+        const auto steps = InterpolationTables::getStepsFor (target, InterpolationTables::lagrange3Curvature);
+
+        for (const auto& r : results)
+            if (r.steps == steps)
+                std::printf ("  %7d dB   %5d   %9.1f dB%s\n", target, steps, toDecibels (r.worstError),
+                             target == InterpolationTables::snrDecibels ? "   (the shifter's)" : "");
+    }
+
+    std::printf ("\n");
+}
+
+//==============================================================================
+static double getMicrosecondsPerShifterBlock (int numChannels, int preparedBlockSize,
+                                              DelayLinePitchShifter::Interpolation interpolation)
+{
+    constexpr int blockSize = 256;
+
+    DelayLinePitchShifter shifter { 4096, 256 };
+    const dsp::ProcessSpec spec { 48000.0, (uint32) preparedBlockSize, (uint32) numChannels };
+
+    DspArena arena;
+    arena.reserve (shifter.getRequiredBytes (spec));
+    shifter.prepare (spec, arena);
+    shifter.setShiftSemitones (5.0f);
+    shifter.setInterpolation (interpolation);
+
+    AudioBuffer<float> buffer (numChannels, blockSize);
+    Random random (1);
+
+    for (int ch = 0; ch < numChannels; ++ch)
+        for (int i = 0; i < blockSize; ++i)
+            buffer.setSample (ch, i, random.nextFloat() * 2.0f - 1.0f);
+
+    dsp::AudioBlock<float> block (buffer);
+    const auto process = [&] { shifter.process (dsp::ProcessContextReplacing<float> (block)); };
+
+    // past the fade from one kind of interpolation to the other
+    for (int i = 0; i < 16; ++i)
+        process();
+
+    constexpr int blocksPerRun = 16;
+
+    return getBestSeconds (100, [&]
+    {
+        for (int i = 0; i < blocksPerRun; ++i)
+            process();
+    }) * 1.0e6 / blocksPerRun;
+}
+
+static void benchShifter()
+{
+    std::printf ("Pitch shifter, per 256-sample block, 5 semitones up, on one thread,\n"
+                 "with its Lagrange weights %s\n\n",
+                 PLAYER_ENGINE_INTERPOLATION_TABLES ? "from the table" : "from the polynomial");
+    std::printf ("  channels   interpolation   kernel            time\n");
+
+    for (const auto numChannels : { 2, 8 })
+    {
+        for (const auto interpolation : { DelayLinePitchShifter::Interpolation::lagrange3,
+                                          DelayLinePitchShifter::Interpolation::linear })
+        {
+            // prepared for another block size, the shifter falls back on its generic kernels
+            for (const auto preparedBlockSize : { 256, 512 })
+            {
+                std::printf ("  %8d   %-13s   %-12s   %6.2f us\n", numChannels,
+                             interpolation == DelayLinePitchShifter::Interpolation::linear ? "linear" : "Lagrange",
+                             preparedBlockSize == 256 ? "specialised" : "generic",
+                             getMicrosecondsPerShifterBlock (numChannels, preparedBlockSize, interpolation));
+            }
+        }
+    }
+
+    std::printf ("\n");
+}
+
+//==============================================================================
+static void benchLevelMeter()
+{
+    constexpr int blockSize = 64;
+    constexpr int blocksPerRun = 64;
+
+    LevelMeter meter;
+    meter.prepare (48000.0, 2);
+
+    AudioBuffer<float> buffer (2, blockSize);
+    Random random (1);
+
+    for (int ch = 0; ch < 2; ++ch)
+        for (int i = 0; i < blockSize; ++i)
+            buffer.setSample (ch, i, random.nextFloat() * 2.0f - 1.0f);
+
+    const auto seconds = getBestSeconds (200, [&]
+    {
+        for (int i = 0; i < blocksPerRun; ++i)
+            meter.measure (buffer, 0, blockSize);
+    });
+
+    std::printf ("Level meter, per stereo 64-sample block\n\n");
+    std::printf ("  %.0f ns\n\n", seconds * 1.0e9 / blocksPerRun);
+}
+
+//==============================================================================
+int main()
+{
+    std::printf ("SIMD kernels built for %s\n\n", getSimdKernels().name);
+
+    benchInterpolation();
+    benchShifter();
+    benchLevelMeter();
+
+    return 0;
+}
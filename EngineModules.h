@@ -0,0 +1,14 @@
+#pragma once
+
+// The playback engine is built on these modules only. Its files include this rather than
+// JuceHeader.h, so anything that reaches for the GUI or graphics modules fails to compile
+// in the PlayerEngine library instead of quietly pulling them in.
+//
+// juce_audio_devices is here for AudioTransportSource, and brings juce_events with it for
+// the engine's AsyncUpdater and change broadcasts. Neither of them depends on the GUI.
+
+#include <juce_audio_devices/juce_audio_devices.h>
+#include <juce_audio_formats/juce_audio_formats.h>
+#include <juce_dsp/juce_dsp.h>
+
+using namespace juce;
@@ -0,0 +1,39 @@
+#include "FixedBlockAdapter.h"
+
+void FixedBlockAdapter::prepare (int numChannels, int newBlockSize)
+{
+    jassert (isPowerOfTwo (newBlockSize));
+
+    // the same layout keeps the audio that's in flight, so a device restart doesn't drop it
+    if ((size_t) numChannels == inputChannels.size() && newBlockSize == blockSize)
+        return;
+
+    blockSize = newBlockSize;
+
+    // each channel is padded to a whole number of cache lines, so they all stay aligned
+    const auto floatsPerLine = (int) (alignment / sizeof (float));
+    const auto stride = (size_t) ((blockSize + floatsPerLine - 1) / floatsPerLine * floatsPerLine);
+
+    storage.calloc (2 * (size_t) numChannels * stride * sizeof (float) + alignment);
+    auto* data = snapPointerToAlignment (reinterpret_cast<float*> (storage.get()), alignment);
+
+    inputChannels.resize ((size_t) numChannels);
+    outputChannels.resize ((size_t) numChannels);
+
+    for (size_t ch = 0; ch < (size_t) numChannels; ++ch)
+    {
+        inputChannels[ch] = data + ch * stride;
+        outputChannels[ch] = data + ((size_t) numChannels + ch) * stride;
+    }
+
+    reset();
+}
+
+void FixedBlockAdapter::reset() noexcept
+{
+    for (auto* channels : { &inputChannels, &outputChannels })
+        for (auto* channel : *channels)
+            FloatVectorOperations::clear (channel, blockSize);
+
+    fifoPosition = 0;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "EngineModules.h"
+
+/** Runs a processing callback on blocks of a fixed, power-of-two size, whatever block
+    sizes the device asks for.
+
+    Incoming samples are collected in a FIFO until a whole block is there. That block
+    is processed in place and played out while the next one is being collected, so
+    the output is delayed by exactly one internal block. Every channel of the internal
+    block starts on a 64-byte boundary, so kernels running on it can rely on aligned,
+    full-width vectors with no remainder loop.
+*/
+class FixedBlockAdapter final
+{
+public:
+    FixedBlockAdapter() = default;
+
+    /** Sets up the FIFOs. Nothing changes if they are already this size. */
+    void prepare (int numChannels, int blockSize);
+    void reset() noexcept;
+
+    int getBlockSize() const noexcept           { return blockSize; }
+
+    /** The adapter delays its output by one internal block. */
+    int getLatencySamples() const noexcept      { return blockSize; }
+
+    /** Pushes a device block through. processBlock is called with a dsp::AudioBlock<float> for
+        each internal block that fills up along the way.
+    */
+    template <typename ProcessBlock>
+    void process (AudioBuffer<float>& buffer, int startSample, int numSamples, ProcessBlock&& processBlock)
+    {
+        const auto numChannels = jmin (buffer.getNumChannels(), (int) inputChannels.size());
+
+        for (int done = 0; done < numSamples;)
+        {
+            const auto num = jmin (numSamples - done, blockSize - fifoPosition);
+
+            for (int ch = 0; ch < numChannels; ++ch)
+            {
+                auto* io = buffer.getWritePointer (ch, startSample + done);
+
+                FloatVectorOperations::copy (inputChannels[(size_t) ch] + fifoPosition, io, num);
+                FloatVectorOperations::copy (io, outputChannels[(size_t) ch] + fifoPosition, num);
+            }
+
+            fifoPosition += num;
+            done += num;
+
+            if (fifoPosition == blockSize)
+            {
+                dsp::AudioBlock<float> block (inputChannels.data(), inputChannels.size(), (size_t) blockSize);
+                processBlock (block);
+
+                // the block that was just processed is played out while the next one fills
+                std::swap (inputChannels, outputChannels);
+                fifoPosition = 0;
+            }
+        }
+
+        for (int ch = numChannels; ch < buffer.getNumChannels(); ++ch)
+            buffer.clear (ch, startSample, numSamples);
+    }
+
+private:
+    static constexpr size_t alignment = 64;
+
+    HeapBlock<char> storage;
+    std::vector<float*> inputChannels, outputChannels;
+    int blockSize = 0, fifoPosition = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (FixedBlockAdapter)
+};
@@ -53,70 +53,128 @@
 #pragma once
 
 #include "DemoUtilities.h"
+#include "StartupTimer.h"
+#include "TrackSwitcher.h"
+#include "PlaybackEngine.h"
+#include "SpectrumAnalyser.h"
+#include "LevelMeter.h"
+#include "TrackAnalyser.h"
+#include "RealtimeSetup.h"
 #include "DSPDemos_Common.h"
-#include "PitchShiftWrapper.h"
-#include <chowdsp_dsp_utils/chowdsp_dsp_utils.h>
+#include "IIRFilterDemoDSP.h"
 
 using namespace dsp;
 
 //==============================================================================
-struct IIRFilterDemoDSP
+/** The controls shown for IIRFilterDemoDSP, and how they map onto its setters. Speed and
+    direction aren't the chain's business: DSPDemo hands those to the PlaybackEngine.
+*/
+struct IIRFilterDemoControls
 {
-    void prepare (const ProcessSpec& spec)
+    using Processor = IIRFilterDemoDSP;
+
+    /** Called on the message thread for each parameter whose value has changed. */
+    void parameterChanged (DSPDemoParameterBase& p, Processor& processor)
     {
-        sampleRate = spec.sampleRate;
-        shifter.prepare (spec);
+        if (&p == &pitchParam)
+        {
+            const auto semitones = static_cast<float> (pitchParam.getCurrentValue());
+            processor.setPitchSemitones (semitones);
 
-        //iir.state = IIR::Coefficients<float>::makeLowPass (sampleRate, 440.0);
-        //iir.prepare (spec);
-    }
+            // the shifter picks its window from the shift, so say when that changes
+            const auto configuration = processor.getShifterConfigurationFor (semitones);
 
-    void process (const ProcessContextReplacing<float>& context)
-    {
-        //iir.process (context);
-        shifter.process (context);
+            if (! exactlyEqual (semitones, 0.0f) && configuration != loggedShifterConfiguration)
+            {
+                loggedShifterConfiguration = configuration;
+                Logger::writeToLog ("Pitch shifter: " + processor.getShifterReport (configuration));
+            }
+        }
+        else if (&p == &compensationParam)
+            processor.setLatencyCompensation (compensationParam.getCurrentSelectedID() == 1);
+        else if (&p == &targetTempoParam || &p == &targetKeyParam)
+            matchTargets();
+
+        //auto cutoff = static_cast<float> (cutoffParam.getCurrentValue());
+        //auto qVal   = static_cast<float> (qParam.getCurrentValue());
+        //auto qVal = 0.71f;
+        //*iir.state = IIR::ArrayCoefficients<float>::makeLowPass  (sampleRate, cutoff, qVal);
+
+        // switch (typeParam.getCurrentSelectedID())
+        // {
+        //     case 1:     *iir.state = IIR::ArrayCoefficients<float>::makeLowPass  (sampleRate, cutoff, qVal); break;
+        //     case 2:     *iir.state = IIR::ArrayCoefficients<float>::makeHighPass (sampleRate, cutoff, qVal); break;
+        //     case 3:     *iir.state = IIR::ArrayCoefficients<float>::makeBandPass (sampleRate, cutoff, qVal); break;
+        //     default:    break;
+        // }
     }
 
-    void reset()
+    /** Called on the message thread once the current file has been analysed. The targets
+        are set to what was found, without touching the speed or pitch, so they start out
+        describing the file as it is.
+    */
+    void setTrackAnalysis (const TrackAnalysis& newAnalysis)
     {
-        //iir.reset();
-        shifter.reset();
+        analysis = newAnalysis;
+
+        if (analysis.hasTempo())
+            targetTempoParam.setCurrentValue (analysis.bpm, dontSendNotification);
+
+        if (analysis.hasKey())
+            targetKeyParam.setCurrentSelectedID (getKeyID (analysis.keyPitchClass, analysis.minor), dontSendNotification);
     }
 
-    void updateParameters()
+    // Speed changes the pitch along with the tempo, so the shifter makes up the difference
+    // between where that leaves the key and the key that's wanted. A minor key is matched
+    // through its relative major, as a shift can't change the mode.
+    void matchTargets()
     {
-        if (! approximatelyEqual (sampleRate, 0.0))
+        if (analysis.hasTempo())
+            tempoParam.setCurrentValue (targetTempoParam.getCurrentValue() / analysis.bpm);
+
+        if (analysis.hasKey())
         {
-            shifter.setShiftSemitones (pitchParam.getCurrentValue());
-
-            //auto cutoff = static_cast<float> (cutoffParam.getCurrentValue());
-            //auto qVal   = static_cast<float> (qParam.getCurrentValue());
-            //auto qVal = 0.71f;
-            //*iir.state = IIR::ArrayCoefficients<float>::makeLowPass  (sampleRate, cutoff, qVal);
-
-            // switch (typeParam.getCurrentSelectedID())
-            // {
-            //     case 1:     *iir.state = IIR::ArrayCoefficients<float>::makeLowPass  (sampleRate, cutoff, qVal); break;
-            //     case 2:     *iir.state = IIR::ArrayCoefficients<float>::makeHighPass (sampleRate, cutoff, qVal); break;
-            //     case 3:     *iir.state = IIR::ArrayCoefficients<float>::makeBandPass (sampleRate, cutoff, qVal); break;
-            //     default:    break;
-            // }
+            const auto id = targetKeyParam.getCurrentSelectedID() - 1;
+            const TrackAnalysis target { 0.0, id / 2, id % 2 == 1 };
+
+            const auto varispeedShift = 12.0 * std::log2 (tempoParam.getCurrentValue());
+            const auto shift = target.getRelativeMajorPitchClass() - analysis.getRelativeMajorPitchClass() - varispeedShift;
+
+            // the nearest way there, up or down
+            pitchParam.setCurrentValue (shift - 12.0 * std::floor ((shift + 6.0) / 12.0));
         }
     }
 
-    //==============================================================================
-    //ProcessorDuplicator<IIR::Filter<float>, IIR::Coefficients<float>> iir;
-    //PitchShiftWrapper pitchShifter;
-    chowdsp::PitchShifter<float, chowdsp::DelayLineInterpolationTypes::Lagrange3rd> shifter { 4096, 256 };
+    static int getKeyID (int pitchClass, bool minor)    { return pitchClass * 2 + (minor ? 1 : 0) + 1; }
+
+    static StringArray getKeyNames()
+    {
+        StringArray names;
+
+        for (int pitchClass = 0; pitchClass < 12; ++pitchClass)
+            for (const auto minor : { false, true })
+                names.add (TrackAnalysis::getKeyName (pitchClass, minor));
+
+        return names;
+    }
 
     //ChoiceParameter typeParam { { "Low-pass", "High-pass", "Band-pass" }, 1, "Type" };
     //SliderParameter cutoffParam { { 20.0, 20000.0 }, 0.5, 440.0f, "Cutoff", "Hz" };
     //SliderParameter qParam { { 0.3, 20.0 }, 0.5, 1.0 / std::sqrt (2.0), "Q" };
-    SliderParameter pitchParam { { 0.0, 12.0 }, 1.0, 0.0f, "Pitch", "", 1.0f };
-    SliderParameter tempoParam { { 0.25, 2.0 }, 1.0, 1.0, "Speed", "x", 0.25 };
-
-    std::vector<DSPDemoParameterBase*> parameters { &pitchParam, &tempoParam };
-    double sampleRate = 0.0;
+    // fine enough for the fractional shift that matching a key at another speed needs
+    SliderParameter pitchParam { { -12.0, 12.0 }, 1.0, 0.0f, "Pitch", "", 0.01 };
+    SliderParameter tempoParam { { 0.25, 2.0 }, 1.0, 1.0, "Speed", "x", 0.01 };
+    ChoiceParameter directionParam { { "Forward", "Reverse" }, 1, "Direction" };
+    ChoiceParameter compensationParam { { "Compensated", "Lowest latency" }, 1, "Bypass" };
+    SliderParameter targetTempoParam { { 40.0, 240.0 }, 1.0, 120.0, "Target tempo", "bpm", 0.1 };
+    ChoiceParameter targetKeyParam { getKeyNames(), 1, "Target key" };
+
+    std::vector<DSPDemoParameterBase*> parameters { &pitchParam, &tempoParam, &directionParam, &compensationParam,
+                                                    &targetTempoParam, &targetKeyParam };
+
+    // message thread only
+    TrackAnalysis analysis;
+    int loggedShifterConfiguration = -1;
 };
 
 struct IIRFilterDemo final : public Component
@@ -124,7 +182,7 @@ struct IIRFilterDemo final : public Component
     IIRFilterDemo()
     {
         addAndMakeVisible (fileReaderComponent);
-        setSize (750, 500);
+        setSize (750, 650);
     }
 
     void resized() override
@@ -132,5 +190,5 @@ struct IIRFilterDemo final : public Component
         fileReaderComponent.setBounds (getLocalBounds());
     }
 
-    AudioFileReaderComponent<IIRFilterDemoDSP> fileReaderComponent;
+    AudioFileReaderComponent<IIRFilterDemoControls> fileReaderComponent;
 };
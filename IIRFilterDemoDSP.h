@@ -0,0 +1,233 @@
+#pragma once
+
+#include "EngineModules.h"
+#include "DspArena.h"
+#include "ChannelGroupPool.h"
+#include "DelayLinePitchShifter.h"
+#include "CompensationDelay.h"
+#include "SimdKernels.h"
+
+/** The player's processing chain: the pitch shifter, with a dry path that's kept lined up
+    with it so that it can be bypassed without a jump in time.
+
+    The setters can be called from any thread and are picked up at the next block; the rest
+    belongs to the audio thread. Nothing in here knows about the controls that drive it.
+*/
+struct IIRFilterDemoDSP
+{
+    void prepare (const dsp::ProcessSpec& spec)
+    {
+        sampleRate = spec.sampleRate;
+
+        // A new device with the same layout keeps the chain's memory and its state, and
+        // only what depends on the sample rate is worked out again.
+        const auto layoutChanged = spec.numChannels != preparedSpec.numChannels
+                                    || spec.maximumBlockSize > preparedSpec.maximumBlockSize;
+
+        if (layoutChanged)
+        {
+            // All of the chain's state comes out of one arena, laid out in the order it's
+            // processed: the dry copy and the crossfade's ramp, the dry copy's compensation
+            // delay, then the shifter's lines.
+            const auto dryBytes = (spec.numChannels + 1) * DspArena::getAlignedSize<float> (spec.maximumBlockSize);
+
+            arena.reserve (dryBytes + compensation.getRequiredBytes (spec) + shifter.getRequiredBytes (spec),
+                           arenaOptions);
+
+            dryChannels.resize (spec.numChannels);
+
+            for (auto& channel : dryChannels)
+                channel = arena.allocate<float> (spec.maximumBlockSize);
+
+            mixRamp = arena.allocate<float> (spec.maximumBlockSize);
+
+            compensation.prepare (spec, arena);
+            shifter.prepare (spec, arena);
+
+            warmupRemaining = 0;
+            preparedSpec = spec;
+        }
+
+        shifterMix.reset (spec.sampleRate, 0.01);
+        shifterMix.setCurrentAndTargetValue (shifterEnabled ? 1.0f : 0.0f);
+
+        //iir.state = IIR::Coefficients<float>::makeLowPass (sampleRate, 440.0);
+        //iir.prepare (spec);
+    }
+
+    void process (const dsp::ProcessContextReplacing<float>& context)
+    {
+        // Values published by the message thread are picked up at the block boundary,
+        // so the audio thread never has to wait on a lock for a parameter update.
+        const auto pitch = pitchTarget.load (std::memory_order_relaxed);
+
+        if (! exactlyEqual (pitch, appliedPitch))
+        {
+            shifter.setShiftSemitones (pitch);
+            appliedPitch = pitch;
+        }
+
+        const auto shouldEnable = ! exactlyEqual (pitch, 0.0f);
+
+        if (shouldEnable != shifterEnabled)
+        {
+            shifterEnabled = shouldEnable;
+
+            // the shifter's delay line is empty after a bypass, so it runs unheard until
+            // it's full before fading in; if it's still fading out, it never stopped running
+            // and its lines are full, so it just fades back in from where it is
+            if (shifterEnabled)
+            {
+                if (shifterMix.getCurrentValue() > 0.0f)
+                    shifterMix.setTargetValue (1.0f);
+                else
+                    warmupRemaining = shifterLatency;
+            }
+            else
+            {
+                warmupRemaining = 0;
+                shifterMix.setTargetValue (0.0f);
+
+                if (! shifterMix.isSmoothing())
+                    shifter.reset();
+            }
+        }
+
+        auto& block = context.getOutputBlock();
+        const auto numSamples = (int) block.getNumSamples();
+        auto dry = dsp::AudioBlock<float> (dryChannels.data(), dryChannels.size(), (size_t) numSamples);
+
+        // The dry path is always kept running, delayed to line up with the shifter when
+        // compensation is on, so it's ready the moment the shifter is bypassed.
+        dry.copyFrom (block);
+
+        if (compensate.load (std::memory_order_relaxed))
+            compensation.process (dsp::ProcessContextReplacing<float> (dry));
+
+        const auto shifterRunning = shifterEnabled || shifterMix.getCurrentValue() > 0.0f;
+
+        if (! shifterRunning)
+        {
+            block.copyFrom (dry);
+            return;
+        }
+
+        //iir.process (context);
+        shifter.process (context, &groupPool);
+
+        if (warmupRemaining > 0)
+        {
+            warmupRemaining = jmax (0, warmupRemaining - numSamples);
+            block.copyFrom (dry);
+
+            if (warmupRemaining == 0)
+                shifterMix.setTargetValue (1.0f);
+
+            return;
+        }
+
+        if (shifterMix.isSmoothing())
+        {
+            mixWithDry (block, dry);
+
+            // fully bypassed now, so it starts from silence next time
+            if (! shifterEnabled && ! shifterMix.isSmoothing())
+                shifter.reset();
+        }
+    }
+
+    void reset()
+    {
+        //iir.reset();
+        shifter.reset();
+        compensation.reset();
+        shifterMix.setCurrentAndTargetValue (shifterEnabled ? 1.0f : 0.0f);
+        warmupRemaining = 0;
+    }
+
+    /** Returns the delay of the whole chain in samples, which is the sum of what each
+        stage reports. A bypassed stage still counts while its path is compensated.
+    */
+    int getLatencySamples() const noexcept
+    {
+        const auto shifterActive = ! exactlyEqual (pitchTarget.load (std::memory_order_relaxed), 0.0f);
+        return shifterActive || compensate.load (std::memory_order_relaxed) ? shifterLatency : 0;
+    }
+
+    /** Sets the pitch shift in semitones. At zero the shifter is bypassed. */
+    void setPitchSemitones (float semitones) noexcept
+    {
+        pitchTarget.store (semitones, std::memory_order_relaxed);
+    }
+
+    /** When on, the dry path is delayed to line up with the shifter, so that bypassing it
+        doesn't jump in time. When off, a bypassed chain has no latency at all.
+    */
+    void setLatencyCompensation (bool shouldCompensate) noexcept
+    {
+        compensate.store (shouldCompensate, std::memory_order_relaxed);
+    }
+
+    /** Returns which of the shifter's windows a shift uses, and a description of them all
+        with that one marked. Both can be called from any thread.
+    */
+    int getShifterConfigurationFor (float semitones) const noexcept     { return shifter.getConfigurationFor (semitones); }
+    String getShifterReport (int highlighted) const                     { return shifter.getConfigurationReport (highlighted); }
+
+    /** Follows a QualityGovernor tier: above full quality, the shifter reads its delay lines
+        with linear instead of Lagrange interpolation. Called on the audio thread.
+    */
+    void setQualityTier (int tier) noexcept
+    {
+        shifter.setInterpolation (tier > 0 ? DelayLinePitchShifter::Interpolation::linear
+                                           : DelayLinePitchShifter::Interpolation::lagrange3);
+    }
+
+    //==============================================================================
+    /** Crossfades from the dry path to the shifter's output in place, following shifterMix. */
+    void mixWithDry (dsp::AudioBlock<float>& block, const dsp::AudioBlock<float>& dry) noexcept
+    {
+        const auto numSamples = block.getNumSamples();
+
+        // the ramp is the same for every channel, so it's only worked out once
+        for (size_t i = 0; i < numSamples; ++i)
+            mixRamp[i] = shifterMix.getNextValue();
+
+        for (size_t ch = 0; ch < block.getNumChannels(); ++ch)
+            kernels.crossfade (block.getChannelPointer (ch), dry.getChannelPointer (ch), mixRamp, (int) numSamples);
+    }
+
+    //==============================================================================
+    static constexpr int shifterSize = 4096;
+    static constexpr int shifterOverlap = 256;
+
+    // the read heads sweep the whole delay line, so on average they're half of it behind
+    static constexpr int shifterLatency = shifterSize / 2;
+
+    static constexpr int arenaOptions = DspArena::hugePages | DspArena::lockInMemory;
+
+    const SimdKernels& kernels = getSimdKernels();
+
+    //ProcessorDuplicator<IIR::Filter<float>, IIR::Coefficients<float>> iir;
+    //PitchShiftWrapper pitchShifter;
+    DelayLinePitchShifter shifter { shifterSize, shifterOverlap };
+
+    // only pays off with more than one channel group, the pool works out when that is
+    ChannelGroupPool groupPool;
+    CompensationDelay compensation { shifterLatency };
+
+    double sampleRate = 0.0;
+
+    std::atomic<float> pitchTarget { 0.0f };
+    std::atomic<bool> compensate { true };
+    float appliedPitch = 0.0f;
+
+    // audio thread only
+    dsp::ProcessSpec preparedSpec {};
+    DspArena arena;
+    std::vector<float*> dryChannels;
+    float* mixRamp = nullptr;
+    SmoothedValue<float> shifterMix;
+    bool shifterEnabled = false;
+    int warmupRemaining = 0;
+};
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "EngineModules.h"
+
+/** Opens a URL for reading, whether it's a local file, an Android document or a remote URL. */
+inline std::unique_ptr<InputSource> makeInputSource (const URL& url)
+{
+    if (const auto doc = AndroidDocument::fromDocument (url))
+        return std::make_unique<AndroidDocumentInputSource> (doc);
+
+   #if ! JUCE_IOS
+    if (url.isLocalFile())
+        return std::make_unique<FileInputSource> (url.getLocalFile());
+   #endif
+
+    return std::make_unique<URLInputSource> (url);
+}
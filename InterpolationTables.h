@@ -0,0 +1,106 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+
+/** Set this to 1 to have the pitch shifter look its Lagrange weights up in lagrange3Table
+    rather than work them out with the polynomial on every sample. It's off by default, as the
+    polynomial is exact and, weight for weight, quicker than a lookup. The build sets it from
+    the PLAYER_ENGINE_INTERPOLATION_TABLES option, and PlayerEngineBench shows what it's worth
+    on a given machine.
+*/
+#ifndef PLAYER_ENGINE_INTERPOLATION_TABLES
+ #define PLAYER_ENGINE_INTERPOLATION_TABLES 0
+#endif
+
+/** Fractional-delay weights, tabulated at compile time.
+
+    A table holds the weights of the four samples around a fractional position at evenly
+    spaced points, and a lookup interpolates linearly between the two points either side.
+    The error of that is at most M h^2 / 8 per weight, for a spacing h and the largest
+    second derivative M of the weight, so the number of points can be worked out from
+    the signal-to-noise ratio the table has to keep with a full-scale signal.
+*/
+namespace InterpolationTables
+{
+    struct FourWeights
+    {
+        float w[4];
+    };
+
+    /** 3rd-order Lagrange weights for the samples at -1, 0, 1 and 2 around t in [0, 1]. */
+    constexpr FourWeights lagrange3 (double t) noexcept
+    {
+        const auto d0 = t + 1.0, d1 = t, d2 = t - 1.0, d3 = t - 2.0;
+
+        return { { (float) (-d1 * d2 * d3 / 6.0), (float) (d0 * d2 * d3 / 2.0),
+                   (float) (-d0 * d1 * d3 / 2.0), (float) (d0 * d1 * d2 / 6.0) } };
+    }
+
+    /** The same weights in float, straight from the polynomial. */
+    inline void lagrange3Weights (float t, float* weights) noexcept
+    {
+        const auto d0 = t + 1.0f, d1 = t, d2 = t - 1.0f, d3 = t - 2.0f;
+
+        weights[0] = -d1 * d2 * d3 / 6.0f;
+        weights[1] =  d0 * d2 * d3 / 2.0f;
+        weights[2] = -d0 * d1 * d3 / 2.0f;
+        weights[3] =  d0 * d1 * d2 / 6.0f;
+    }
+
+    // the sum over the four weights of the largest second derivative on [0, 1]
+    inline constexpr double lagrange3Curvature = 1.0 + 2.0 + 2.0 + 1.0;
+
+    /** Returns the smallest power-of-two number of steps for which a table of weights with
+        the given curvature keeps the error on a full-scale signal snrDecibels down.
+    */
+    constexpr int getStepsFor (int snrDecibels, double curvature) noexcept
+    {
+        auto allowed = 1.0;
+
+        for (int dB = 0; dB < snrDecibels; ++dB)
+            allowed /= 1.1220184543019633;  // 10^(1/20)
+
+        auto steps = 1;
+
+        while (curvature / (8.0 * steps * steps) > allowed && steps < (1 << 16))
+            steps *= 2;
+
+        return steps;
+    }
+
+    /** A table of weights at Steps + 1 evenly spaced points from 0 to 1. */
+    template <int Steps>
+    struct WeightTable
+    {
+        template <typename WeightFunction>
+        constexpr explicit WeightTable (WeightFunction weightsAt) noexcept
+        {
+            for (int i = 0; i <= Steps; ++i)
+                points[(std::size_t) i] = weightsAt ((double) i / Steps);
+        }
+
+        /** Writes the weights at t in [0, 1]. A fraction worked out as x - floor (x) can
+            round up to exactly 1 for an x just below an integer, so that end is included.
+        */
+        void lookup (float t, float* weights) const noexcept
+        {
+            const auto position = t * (float) Steps;
+            const auto index = position < (float) Steps ? (int) position : Steps - 1;
+            const auto f = position - (float) index;
+
+            const auto& a = points[(std::size_t) index].w;
+            const auto& b = points[(std::size_t) index + 1].w;
+
+            for (int k = 0; k < 4; ++k)
+                weights[k] = a[k] + f * (b[k] - a[k]);
+        }
+
+        std::array<FourWeights, Steps + 1> points {};
+    };
+
+    /** Good for 96 dB, the noise floor of 16-bit audio. That takes 256 steps, 4 KB. */
+    inline constexpr int snrDecibels = 96;
+
+    inline constexpr WeightTable<getStepsFor (snrDecibels, lagrange3Curvature)> lagrange3Table { lagrange3 };
+}
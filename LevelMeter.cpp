@@ -0,0 +1,43 @@
+#include "LevelMeter.h"
+
+void LevelMeter::prepare (double newSampleRate, int newNumChannels) noexcept
+{
+    sampleRate = newSampleRate;
+    numChannels = jlimit (0, maxNumChannels, newNumChannels);
+    reset();
+}
+
+void LevelMeter::reset() noexcept
+{
+    for (int ch = 0; ch < maxNumChannels; ++ch)
+    {
+        peaks[(size_t) ch].store (0.0f, std::memory_order_relaxed);
+        meanSquares[(size_t) ch].store (0.0f, std::memory_order_relaxed);
+    }
+}
+
+void LevelMeter::measure (const AudioBuffer<float>& buffer, int startSample, int numSamples) noexcept
+{
+    if (numSamples <= 0)
+        return;
+
+    const auto channels = jmin (buffer.getNumChannels(), getNumChannels());
+
+    // The ballistics depend on how long the block is, which can change from one to the next.
+    // The peak falls by 60 dB, a factor of e^-6.9, over peakFallSeconds.
+    const auto peakFall = (float) std::exp (-numSamples / (peakFallSeconds * sampleRate) * 6.9);
+    const auto rmsCoeff = (float) (1.0 - std::exp (-numSamples / (rmsSeconds * sampleRate)));
+
+    for (int ch = 0; ch < channels; ++ch)
+    {
+        auto blockPeak = 0.0f, sumOfSquares = 0.0f;
+        kernels.measureLevel (buffer.getReadPointer (ch, startSample), numSamples, blockPeak, sumOfSquares);
+
+        auto& peak = peaks[(size_t) ch];
+        peak.store (jmax (blockPeak, peak.load (std::memory_order_relaxed) * peakFall), std::memory_order_relaxed);
+
+        auto& meanSquare = meanSquares[(size_t) ch];
+        const auto previous = meanSquare.load (std::memory_order_relaxed);
+        meanSquare.store (previous + (sumOfSquares / (float) numSamples - previous) * rmsCoeff, std::memory_order_relaxed);
+    }
+}
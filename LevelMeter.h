@@ -0,0 +1,47 @@
+#pragma once
+
+#include "EngineModules.h"
+#include "SimdKernels.h"
+
+/** Measures the peak and RMS level of each channel of the output, on the audio thread.
+
+    Each block is measured in one vectorised pass per channel. The peak holds the largest
+    sample and falls away from it, and the RMS is averaged over about 300 ms, so whatever
+    rate the levels are read at, no peak is missed between reads. Both are stored in
+    atomics that only the audio thread writes to, and can be read from any thread.
+*/
+class LevelMeter final
+{
+public:
+    static constexpr int maxNumChannels = 8;
+
+    LevelMeter() = default;
+
+    void prepare (double sampleRate, int numChannels) noexcept;
+    void reset() noexcept;
+
+    /** Called on the audio thread with every block that's played. */
+    void measure (const AudioBuffer<float>& buffer, int startSample, int numSamples) noexcept;
+
+    int getNumChannels() const noexcept                 { return numChannels.load (std::memory_order_relaxed); }
+
+    /** Returns the peak level of a channel as a gain. */
+    float getPeak (int channel) const noexcept          { return peaks[(size_t) channel].load (std::memory_order_relaxed); }
+
+    /** Returns the RMS level of a channel as a gain. */
+    float getRMS (int channel) const noexcept           { return std::sqrt (meanSquares[(size_t) channel].load (std::memory_order_relaxed)); }
+
+private:
+    static constexpr double peakFallSeconds = 1.5;
+    static constexpr double rmsSeconds = 0.3;
+
+    const SimdKernels& kernels = getSimdKernels();
+
+    std::atomic<int> numChannels { 0 };
+    std::array<std::atomic<float>, maxNumChannels> peaks {}, meanSquares {};
+
+    // audio thread only
+    double sampleRate = 44100.0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (LevelMeter)
+};
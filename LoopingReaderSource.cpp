@@ -0,0 +1,267 @@
+#include "LoopingReaderSource.h"
+
+LoopingReaderSource::LoopingReaderSource (AudioFormatReader& r)
+    : reader (r)
+{
+    // mono files are read onto both sides, like AudioFormatReader::read() does
+    const auto numChannels = jmax (2, (int) reader.numChannels);
+
+    head.setSize (numChannels, headSize);
+    tail.setSize (numChannels, fadeSize);
+}
+
+void LoopingReaderSource::setLoopRegion (Range<int64> region)
+{
+    {
+        const SpinLock::ScopedLockType sl (loopLock);
+        requestedRegion = region;
+    }
+
+    loopChanged = true;
+}
+
+Range<int64> LoopingReaderSource::getLoopRegion() const
+{
+    const SpinLock::ScopedLockType sl (loopLock);
+    return requestedRegion;
+}
+
+void LoopingReaderSource::setLooping (bool shouldLoop)
+{
+    looping = shouldLoop;
+    loopChanged = true;
+}
+
+int64 LoopingReaderSource::getTotalLength() const
+{
+    // While looping the stream never ends. This is long enough for anyone, but still
+    // small enough not to overflow when a transport scales it to another sample rate.
+    // An empty file has nothing to loop, so it ends straight away.
+    constexpr auto endless = (int64) 1 << 48;
+
+    if (reader.lengthInSamples <= 0)
+        return reader.lengthInSamples;
+
+    const auto latest = getMappings().getLatest();
+
+    return looping || latest.isLooping() ? endless : latest.offset + reader.lengthInSamples;
+}
+
+int64 LoopingReaderSource::getFilePosition (int64 readPosition) const noexcept
+{
+    const auto current = getMappings();
+    return jmax ((int64) 0, current.items[(size_t) current.indexFor (readPosition)].getFilePosition (readPosition));
+}
+
+int64 LoopingReaderSource::Mapping::getFilePosition (int64 readPosition) const noexcept
+{
+    const auto position = readPosition - offset;
+
+    if (! isLooping() || position < loopEnd)
+        return position;
+
+    return loopStart + (position - loopEnd) % (loopEnd - loopStart);
+}
+
+int LoopingReaderSource::Mappings::indexFor (int64 readPosition) const noexcept
+{
+    // anything from before the oldest mapping that's kept is read with that one
+    auto index = size - 1;
+
+    while (index > 0 && readPosition < items[(size_t) index].from)
+        --index;
+
+    return index;
+}
+
+LoopingReaderSource::Mappings LoopingReaderSource::getMappings() const noexcept
+{
+    const SpinLock::ScopedLockType sl (mappingLock);
+
+    if (! resetPending)
+        return mappings;
+
+    // a reset that hasn't been picked up yet already counts for anyone asking
+    Mappings plain;
+    plain.items[0] = { 0, 0, mappings.getLatest().loopStart, mappings.getLatest().loopEnd };
+
+    return plain;
+}
+
+bool LoopingReaderSource::resetMapping() noexcept
+{
+    const SpinLock::ScopedLockType sl (mappingLock);
+
+    if (mappings.size == 1 && mappings.items[0].offset == 0)
+        return resetPending;
+
+    resetPending = true;
+    return true;
+}
+
+void LoopingReaderSource::applyPendingReset() noexcept
+{
+    const SpinLock::ScopedLockType sl (mappingLock);
+
+    if (! std::exchange (resetPending, false))
+        return;
+
+    const auto latest = mappings.getLatest();
+
+    mappings.items[0] = { 0, 0, latest.loopStart, latest.loopEnd };
+    mappings.size = 1;
+}
+
+//==============================================================================
+void LoopingReaderSource::getNextAudioBlock (const AudioSourceChannelInfo& bufferToFill)
+{
+    applyPendingReset();
+
+    auto& buffer = *bufferToFill.buffer;
+    const auto numChannels = jmin (buffer.getNumChannels(), head.getNumChannels());
+    const auto current = getMappings();
+
+    auto position = nextReadPosition.load();
+
+    for (int done = 0; done < bufferToFill.numSamples;)
+    {
+        const auto destStart = bufferToFill.startSample + done;
+        auto num = bufferToFill.numSamples - done;
+
+        const auto index = current.indexFor (position);
+        const auto& mapping = current.items[(size_t) index];
+
+        // the head and tail are only kept for the latest loop, an older one wraps without a fade
+        const auto isLatest = index == current.size - 1;
+
+        if (! isLatest)
+            num = (int) jmin ((int64) num, current.items[(size_t) index + 1].from - position);
+
+        const auto filePosition = position - mapping.offset;
+
+        if (! mapping.isLooping() || filePosition < mapping.loopEnd)
+        {
+            // before the first wrap the stream is just the file
+            if (mapping.isLooping())
+                num = (int) jmin ((int64) num, mapping.loopEnd - filePosition);
+
+            readFromFile (buffer, destStart, num, filePosition);
+        }
+        else
+        {
+            const auto loopLength = mapping.loopEnd - mapping.loopStart;
+            const auto offset = (filePosition - mapping.loopEnd) % loopLength;
+
+            if (isLatest && offset < fadeLength)
+            {
+                // the loop start fades in over the samples that follow the loop end
+                num = (int) jmin ((int64) num, fadeLength - offset);
+
+                for (int i = 0; i < num; ++i)
+                {
+                    const auto headIndex = (int) offset + i;
+                    const auto t = ((float) headIndex + 0.5f) / (float) fadeLength;
+                    const auto gainIn  = std::sin (t * MathConstants<float>::halfPi);
+                    const auto gainOut = std::cos (t * MathConstants<float>::halfPi);
+
+                    for (int ch = 0; ch < numChannels; ++ch)
+                        buffer.setSample (ch, destStart + i, head.getSample (ch, headIndex) * gainIn
+                                                               + tail.getSample (ch, headIndex) * gainOut);
+                }
+            }
+            else if (isLatest && offset < headLength)
+            {
+                num = (int) jmin ((int64) num, headLength - offset);
+
+                for (int ch = 0; ch < numChannels; ++ch)
+                    buffer.copyFrom (ch, destStart, head, ch, (int) offset, num);
+            }
+            else
+            {
+                num = (int) jmin ((int64) num, loopLength - offset);
+                readFromFile (buffer, destStart, num, mapping.loopStart + offset);
+            }
+
+            for (int ch = numChannels; ch < buffer.getNumChannels(); ++ch)
+                buffer.clear (ch, destStart, num);
+        }
+
+        position += num;
+        done += num;
+    }
+
+    nextReadPosition = position;
+}
+
+//==============================================================================
+bool LoopingReaderSource::applyPendingLoop (int64 fromPosition)
+{
+    applyPendingReset();
+
+    if (! loopChanged.exchange (false))
+        return false;
+
+    Range<int64> region;
+
+    {
+        const SpinLock::ScopedLockType sl (loopLock);
+        region = requestedRegion;
+    }
+
+    const Range<int64> wholeFile (0, reader.lengthInSamples);
+    region = region.getIntersectionWith (wholeFile);
+
+    // no region, or one that's off the end of the file, loops the whole of it instead
+    if (region.isEmpty())
+        region = wholeFile;
+
+    Mapping mapping;
+    mapping.from = fromPosition;
+
+    if (looping && ! region.isEmpty())
+    {
+        // a region shorter than two fades gets a shorter crossfade, down to none at all for a
+        // single sample, so that anything that can be selected still loops
+        headLength = (int) jmin ((int64) headSize, region.getLength());
+        fadeLength = jmin (fadeSize, headLength / 2);
+
+        readFromFile (head, 0, headLength, region.getStart());
+        readFromFile (tail, 0, fadeLength, region.getEnd());
+
+        mapping.loopStart = region.getStart();
+        mapping.loopEnd = region.getEnd();
+    }
+
+    // The new mapping carries on from where the old one had got to in the file, or wraps
+    // straight away if that's already past the end of the new loop.
+    const auto filePosition = getFilePosition (fromPosition);
+    mapping.offset = fromPosition - (mapping.isLooping() ? jmin (filePosition, mapping.loopEnd) : filePosition);
+
+    const SpinLock::ScopedLockType sl (mappingLock);
+
+    // As long as nothing has wrapped yet, read positions are still the file's own, and stay so.
+    const auto& latest = mappings.getLatest();
+
+    if (mapping.offset == 0 && mappings.size == 1 && latest.offset == 0
+         && (! latest.isLooping() || fromPosition <= latest.loopEnd))
+    {
+        mappings.items[0] = { 0, 0, mapping.loopStart, mapping.loopEnd };
+        return true;
+    }
+
+    while (mappings.size > 0 && mappings.getLatest().from >= fromPosition)
+        --mappings.size;
+
+    if (mappings.size == maxMappings)
+    {
+        std::move (mappings.items.begin() + 1, mappings.items.end(), mappings.items.begin());
+        --mappings.size;
+    }
+
+    mappings.items[(size_t) mappings.size++] = mapping;
+    return true;
+}
+void LoopingReaderSource::readFromFile (AudioBuffer<float>& dest, int destStart, int numSamples, int64 filePosition)
+{
+    reader.read (&dest, destStart, numSamples, filePosition, true, true);
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "EngineModules.h"
+
+/** Reads from an AudioFormatReader, optionally looping a region of the file.
+
+    The loop is unrolled: read positions keep counting up across the wrap and the
+    looped part is mapped back onto the file, so a read-ahead buffer sitting on top
+    of this source sees one continuous stream and never has to flush. The start of
+    the loop and the few samples after its end are kept decoded in memory, so the
+    wrap needs no seek in the reader, and it's smoothed by a short equal-power
+    crossfade that starts on the exact sample where the loop ends.
+
+    A new loop takes over from a read position on, carrying on from wherever in the file
+    the old one had got to there. Positions before it keep the mapping they were read
+    with, so audio that's still buffered plays and reports the way it was read. Until
+    the loop first wraps, read positions are the file's own; once the mapping has moved
+    away from that, resetMapping() puts them back, e.g. before a seek into the file.
+*/
+class LoopingReaderSource final : public PositionableAudioSource
+{
+public:
+    explicit LoopingReaderSource (AudioFormatReader& reader);
+
+    /** Sets the region to loop, in samples. An empty range, or one outside the file, loops the whole file. */
+    void setLoopRegion (Range<int64> region);
+    Range<int64> getLoopRegion() const;
+
+    /** Maps a read position onto the position in the file it was read from. */
+    int64 getFilePosition (int64 readPosition) const noexcept;
+
+    /** Starts using the loop that was last asked for from a read position on. Called on the
+        reading thread, before it reads from there; returns false if nothing had changed.
+    */
+    bool applyPendingLoop (int64 fromPosition);
+
+    /** Makes read positions the file's own again from the next read on, keeping the current
+        loop. Returns true if they weren't, in which case anything read before is stale.
+        Any thread.
+    */
+    bool resetMapping() noexcept;
+
+    //==============================================================================
+    void prepareToPlay (int, double) override    {}
+    void releaseResources() override             {}
+    void getNextAudioBlock (const AudioSourceChannelInfo& bufferToFill) override;
+
+    void setNextReadPosition (int64 newPosition) override    { nextReadPosition = newPosition; }
+    int64 getNextReadPosition() const override                { return nextReadPosition; }
+    int64 getTotalLength() const override;
+
+    // From the caller's point of view the unrolled stream never wraps
+    bool isLooping() const override                           { return false; }
+    void setLooping (bool shouldLoop) override;
+
+private:
+    /** From read position `from` on, position p reads the file at p - offset, wrapping back
+        to loopStart once that reaches loopEnd. loopEnd is 0 when not looping.
+    */
+    struct Mapping
+    {
+        int64 from = 0, offset = 0, loopStart = 0, loopEnd = 0;
+
+        bool isLooping() const noexcept     { return loopEnd > loopStart; }
+        int64 getFilePosition (int64 readPosition) const noexcept;
+    };
+
+    // enough for the few changes a read-ahead buffer's worth of positions can span
+    static constexpr int maxMappings = 4;
+
+    struct Mappings
+    {
+        std::array<Mapping, maxMappings> items;
+        int size = 1;
+
+        const Mapping& getLatest() const noexcept   { return items[(size_t) size - 1]; }
+        int indexFor (int64 readPosition) const noexcept;
+    };
+
+    Mappings getMappings() const noexcept;
+    void applyPendingReset() noexcept;
+    void readFromFile (AudioBuffer<float>& dest, int destStart, int numSamples, int64 filePosition);
+
+    static constexpr int headSize = 32768;
+    static constexpr int fadeSize = 128;
+
+    AudioFormatReader& reader;
+    std::atomic<int64> nextReadPosition { 0 };
+
+    // set from the message thread, picked up by the reading thread
+    SpinLock loopLock;
+    Range<int64> requestedRegion;
+    std::atomic<bool> looping { false }, loopChanged { true };
+
+    // written by the reading thread, read from anywhere
+    mutable SpinLock mappingLock;
+    Mappings mappings;
+    bool resetPending = false;
+
+    // reading thread only, the head and tail of the latest mapping's loop
+    AudioBuffer<float> head, tail;
+    int headLength = 0, fadeLength = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (LoopingReaderSource)
+};
@@ -18,8 +18,10 @@ public:
     const juce::String getApplicationName() override       { return "Player Demo"; }
     const juce::String getApplicationVersion() override    { return "1.0.0"; }
 
-    void initialise (const juce::String&) override
+    void initialise (const juce::String& commandLine) override
     {
+        startupTimer.start();
+        realtimeSetup.start (commandLine);
         mainWindow.reset (new MainWindow ("PlayerDemo", new IIRFilterDemo, *this));
     }
 
@@ -61,6 +63,9 @@ private:
         JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MainWindow)
     };
 
+    // declared first so that they outlive the window, its threads and its audio callbacks
+    StartupTimer startupTimer;
+    RealtimeSetup realtimeSetup;
     std::unique_ptr<MainWindow> mainWindow;
 };
 
@@ -1,6 +1,6 @@
 #pragma once
 
-#include <JuceHeader.h>
+#include "EngineModules.h"
 #include <chowdsp_dsp_utils/chowdsp_dsp_utils.h>
 
 /** Wrapper for chowdsp::PitchShift */
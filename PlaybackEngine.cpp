@@ -0,0 +1,107 @@
+#include "PlaybackEngine.h"
+#include "RealtimeSetup.h"
+#include "StartupTimer.h"
+
+PlaybackEngine::PlaybackEngine (TrackSwitcher& i, AudioDeviceManager* manager)
+    : input (i),
+      deviceManager (manager)
+{
+}
+
+void PlaybackEngine::prepareToPlay (int blockSize, double sampleRate)
+{
+    input.prepareToPlay (blockSize, sampleRate);
+    resampler.prepareToPlay (blockSize, sampleRate);
+
+    // The chain is as wide as the device's output. The DSP never sees the device's
+    // block size though, only the adapter's.
+    const auto numChannels = getNumOutputChannels();
+
+    blockAdapter.prepare (numChannels, internalBlockSize);
+    processor.prepare ({ sampleRate, (uint32) internalBlockSize, (uint32) numChannels });
+    analyser.prepare (sampleRate, numChannels);
+    levelMeter.prepare (sampleRate, numChannels);
+    governor.prepare (sampleRate, internalBlockSize);
+    audioThreadSetupPending = true;
+
+    preparedSampleRate = sampleRate;
+    updateLatency();
+}
+
+void PlaybackEngine::releaseResources()
+{
+    input.releaseResources();
+    resampler.releaseResources();
+}
+
+void PlaybackEngine::getNextAudioBlock (const AudioSourceChannelInfo& bufferToFill)
+{
+    if (bufferToFill.buffer == nullptr)
+    {
+        jassertfalse;
+        return;
+    }
+
+    StartupTimer::mark (StartupTimer::firstAudioCallback);
+
+    // a new device can mean a new audio thread
+    if (audioThreadSetupPending.exchange (false))
+        RealtimeSetup::applyToCurrentThread (RealtimeSetup::audioThread);
+
+    governor.beginBlock();
+    processor.setQualityTier (governor.getTier());
+
+    if (resetPending.exchange (false))
+    {
+        processor.reset();
+        blockAdapter.reset();
+        resampler.flushBuffers();
+    }
+
+    resampler.getNextAudioBlock (bufferToFill);
+
+    blockAdapter.process (*bufferToFill.buffer, bufferToFill.startSample, bufferToFill.numSamples,
+                          [this] (dsp::AudioBlock<float>& block)
+                          {
+                              processor.process (dsp::ProcessContextReplacing<float> (block));
+                          });
+
+    levelMeter.measure (*bufferToFill.buffer, bufferToFill.startSample, bufferToFill.numSamples);
+    analyser.pushSamples (*bufferToFill.buffer, bufferToFill.startSample, bufferToFill.numSamples);
+
+    governor.endBlock (bufferToFill.numSamples);
+}
+
+//==============================================================================
+void PlaybackEngine::setSpeed (double ratio)
+{
+    speedRatio = ratio;
+    resampler.setResamplingRatio (ratio);
+    updateLatency();
+}
+
+int PlaybackEngine::getLatencySamples() const noexcept
+{
+    return processor.getLatencySamples() + internalBlockSize;
+}
+
+// The chain's latency is in output samples, while the track's playhead counts
+// seconds of the track, which go by faster or slower with the speed.
+void PlaybackEngine::updateLatency()
+{
+    const auto sampleRate = preparedSampleRate.load();
+
+    if (sampleRate > 0.0)
+        input.setOutputLatency (getLatencySamples() / sampleRate * speedRatio.load());
+}
+
+int PlaybackEngine::getNumOutputChannels() const
+{
+    auto numChannels = 2;
+
+    if (deviceManager != nullptr)
+        if (auto* device = deviceManager->getCurrentAudioDevice())
+            numChannels = device->getActiveOutputChannels().countNumberOfSetBits();
+
+    return jlimit (1, TrackSwitcher::maxNumChannels, numChannels);
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "EngineModules.h"
+#include "TrackSwitcher.h"
+#include "FixedBlockAdapter.h"
+#include "SpectrumAnalyser.h"
+#include "LevelMeter.h"
+#include "QualityGovernor.h"
+#include "IIRFilterDemoDSP.h"
+
+/** Everything between a TrackSwitcher and the output: the resampler that sets the speed,
+    the fixed-size blocks the processing chain runs on, and the analyser, meter and quality
+    governor around it. This is the AudioSource to hand to an AudioSourcePlayer, or to pull
+    blocks from directly when rendering without a device.
+
+    It also keeps the track's playhead in step with what can be heard, by telling the
+    TrackSwitcher how far behind the output the chain and the block adapter put it.
+
+    The setters are called on the message thread; the chain's own setters, reached through
+    getProcessor(), can be called from any thread. Call updateLatency() after changing one
+    of those that affects the latency.
+*/
+class PlaybackEngine final : public AudioSource
+{
+public:
+    using Processor = IIRFilterDemoDSP;
+
+    /** With a device manager the chain is as wide as its current device's output, without
+        one it's stereo.
+    */
+    explicit PlaybackEngine (TrackSwitcher& input, AudioDeviceManager* deviceManager = nullptr);
+
+    //==============================================================================
+    void prepareToPlay (int blockSize, double sampleRate) override;
+    void releaseResources() override;
+    void getNextAudioBlock (const AudioSourceChannelInfo& bufferToFill) override;
+
+    //==============================================================================
+    /** Plays the tracks at a ratio of their normal speed, which changes the pitch with it. */
+    void setSpeed (double ratio);
+
+    /** Plays the tracks backwards when true. */
+    void setReverse (bool shouldPlayBackwards) noexcept     { input.setReverse (shouldPlayBackwards); }
+
+    Processor& getProcessor() noexcept                      { return processor; }
+
+    /** Passes the chain's latency on to the TrackSwitcher again. */
+    void updateLatency();
+
+    /** Returns the delay of the processing chain in samples, including the block adapter. */
+    int getLatencySamples() const noexcept;
+
+    /** Clears the DSP state at the start of the next block, e.g. after a track change. */
+    void requestReset() noexcept                            { resetPending = true; }
+
+    /** Returns the analyser that's fed with everything this plays. */
+    SpectrumAnalyser& getSpectrumAnalyser() noexcept        { return analyser; }
+
+    /** Returns the meter that measures everything this plays. */
+    LevelMeter& getLevelMeter() noexcept                    { return levelMeter; }
+
+private:
+    int getNumOutputChannels() const;
+
+    // a power of two, so that every block is a whole number of SIMD vectors
+    static constexpr int internalBlockSize = 256;
+    static_assert (isPowerOfTwo (internalBlockSize));
+
+    static_assert (LevelMeter::maxNumChannels >= TrackSwitcher::maxNumChannels);
+
+    TrackSwitcher& input;
+    AudioDeviceManager* const deviceManager;
+
+    // the resampler only processes as many channels as the buffer it's given has
+    ResamplingAudioSource resampler { &input, false, TrackSwitcher::maxNumChannels };
+
+    Processor processor;
+
+    std::atomic<bool> resetPending { false }, audioThreadSetupPending { false };
+    std::atomic<double> preparedSampleRate { 0.0 }, speedRatio { 1.0 };
+
+    // audio thread only
+    FixedBlockAdapter blockAdapter;
+
+    SpectrumAnalyser analyser { TrackSwitcher::maxNumChannels };
+    LevelMeter levelMeter;
+    QualityGovernor governor;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PlaybackEngine)
+};
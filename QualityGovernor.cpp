@@ -0,0 +1,80 @@
+#include "QualityGovernor.h"
+
+void QualityGovernor::prepare (double newSampleRate, int newSamplesPerMeasurement) noexcept
+{
+    sampleRate = newSampleRate;
+    samplesPerMeasurement = newSamplesPerMeasurement;
+    measuredSamples = 0;
+    measuredSeconds = 0.0;
+    tier.store (0, std::memory_order_relaxed);
+    averageLoad = 0.0f;
+    secondsSinceChange = 0.0;
+    secondsRecovered = 0.0;
+}
+
+void QualityGovernor::endBlock (int numSamples) noexcept
+{
+    if (numSamples <= 0)
+        return;
+
+    measuredSeconds += Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - blockStart);
+    measuredSamples += numSamples;
+
+    if (measuredSamples < samplesPerMeasurement)
+        return;
+
+    const auto blockSeconds = measuredSamples / sampleRate;
+    const auto load = (float) (measuredSeconds / blockSeconds);
+
+    measuredSamples = 0;
+    measuredSeconds = 0.0;
+
+    // averaged over averageSeconds whatever the block size is
+    averageLoad += (load - averageLoad) * (float) (1.0 - std::exp (-blockSeconds / averageSeconds));
+    secondsSinceChange += blockSeconds;
+
+    const auto current = tier.load (std::memory_order_relaxed);
+
+    if (current + 1 < numTiers
+         && secondsSinceChange >= holdSeconds
+         && (load > overloadLoad || averageLoad > averageOverloadLoad))
+    {
+        changeTier (current + 1, jmax (load, averageLoad));
+        return;
+    }
+
+    secondsRecovered = averageLoad < recoveredLoad ? secondsRecovered + blockSeconds : 0.0;
+
+    if (current > 0 && secondsRecovered >= recoverySeconds)
+        changeTier (current - 1, averageLoad);
+}
+
+void QualityGovernor::changeTier (int newTier, float load) noexcept
+{
+    const auto from = tier.exchange (newTier, std::memory_order_relaxed);
+    (newTier > from ? stepsDown : stepsUp).fetch_add (1, std::memory_order_relaxed);
+
+    secondsSinceChange = 0.0;
+    secondsRecovered = 0.0;
+
+    // if the log has fallen that far behind, the counters still have it
+    const auto scope = transitionFifo.write (1);
+
+    if (scope.blockSize1 > 0)
+        transitions[(size_t) scope.startIndex1] = { from, newTier, load };
+}
+
+void QualityGovernor::timerCallback()
+{
+    const auto scope = transitionFifo.read (transitionFifo.getNumReady());
+
+    scope.forEach ([this] (int index)
+    {
+        const auto& t = transitions[(size_t) index];
+
+        Logger::writeToLog ("Quality: " + String (t.to > t.from ? "down" : "up")
+                             + " to tier " + String (t.to) + " at " + String (roundToInt (t.load * 100.0f))
+                             + "% load (" + String (getNumStepsDown()) + " down, "
+                             + String (getNumStepsUp()) + " up so far)");
+    });
+}
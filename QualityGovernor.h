@@ -0,0 +1,77 @@
+#pragma once
+
+#include "EngineModules.h"
+
+/** Steps the quality of the DSP chain down when the audio callback is running out of time,
+    and back up once there's room again.
+
+    The callbacks are timed against the time the audio they produce lasts, added up until
+    they cover at least one block of the processing chain. The chain runs on fixed blocks
+    behind an adapter, so with a small device buffer only one callback in a few does any
+    DSP, and timing that one against its own buffer alone would see several times the real
+    load. A single measurement over more than 90% of the time, or an average load of more
+    than 75% over about 50 ms, drops the quality by one tier straight away; after that the load has to settle before it can drop again.
+    Going back up needs the load to stay under 40% for three seconds, so a chain that only
+    just fits doesn't keep flipping between two tiers.
+
+    The tier is read by the audio thread, which passes it on to the processors; they're
+    expected to make the change without a click. Every step is counted, and logged later
+    on the message thread, which looks for new ones a few times a second: a step is taken
+    exactly when the callback has no time to spare, so it doesn't post a message itself.
+*/
+class QualityGovernor final : private Timer
+{
+public:
+    /** Tier 0 is full quality, each one after it is cheaper. */
+    static constexpr int numTiers = 2;
+
+    QualityGovernor()               { startTimer (logIntervalMs); }
+    ~QualityGovernor() override     { stopTimer(); }
+
+    /** Starts over at full quality. Each measurement covers at least samplesPerMeasurement
+        samples, which should be the block size the chain processes in.
+    */
+    void prepare (double sampleRate, int samplesPerMeasurement) noexcept;
+
+    /** Called on the audio thread around everything the callback does. */
+    void beginBlock() noexcept      { blockStart = Time::getHighResolutionTicks(); }
+    void endBlock (int numSamples) noexcept;
+
+    int getTier() const noexcept                { return tier.load (std::memory_order_relaxed); }
+    int getNumStepsDown() const noexcept        { return stepsDown.load (std::memory_order_relaxed); }
+    int getNumStepsUp() const noexcept          { return stepsUp.load (std::memory_order_relaxed); }
+
+private:
+    void timerCallback() override;
+    void changeTier (int newTier, float load) noexcept;
+
+    static constexpr float overloadLoad = 0.9f;
+    static constexpr float averageOverloadLoad = 0.75f;
+    static constexpr float recoveredLoad = 0.4f;
+    static constexpr double averageSeconds = 0.05;
+    static constexpr double holdSeconds = 0.5;
+    static constexpr double recoverySeconds = 3.0;
+    static constexpr int logIntervalMs = 250;
+
+    struct Transition
+    {
+        int from, to;
+        float load;
+    };
+
+    std::atomic<int> tier { 0 }, stepsDown { 0 }, stepsUp { 0 };
+
+    // transitions waiting to be logged, written on the audio thread only
+    AbstractFifo transitionFifo { 16 };
+    std::array<Transition, 16> transitions {};
+
+    // audio thread only
+    double sampleRate = 44100.0;
+    int samplesPerMeasurement = 0, measuredSamples = 0;
+    int64 blockStart = 0;
+    double measuredSeconds = 0.0;
+    float averageLoad = 0.0f;
+    double secondsSinceChange = 0.0, secondsRecovered = 0.0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (QualityGovernor)
+};
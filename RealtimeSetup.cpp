@@ -0,0 +1,243 @@
+#include "RealtimeSetup.h"
+#include "SimdKernels.h"
+
+#if JUCE_LINUX || JUCE_BSD || JUCE_MAC
+ #include <pthread.h>
+ #include <sched.h>
+ #include <sys/mman.h>
+#elif JUCE_WINDOWS
+ #include <windows.h>
+#endif
+
+static const char* const roleNames[] = { "audio thread", "worker threads", "disk threads", "background threads" };
+static const char* const roleOptions[] = { "--audio-thread=", "--worker-threads=", "--disk-threads=", "--background-threads=" };
+
+RealtimeSetup::~RealtimeSetup()
+{
+    instance = nullptr;
+    stopTimer();
+}
+
+void RealtimeSetup::start (const String& commandLine)
+{
+    auto lockAll = false;
+
+    for (const auto& arg : StringArray::fromTokens (commandLine, true))
+    {
+        for (int role = 0; role < numRoles; ++role)
+            if (arg.startsWith (roleOptions[role]))
+                schedules[(size_t) role] = parseSchedule (arg.fromFirstOccurrenceOf ("=", false, false).unquoted());
+
+        lockAll = lockAll || arg == "--lock-memory";
+    }
+
+    Logger::writeToLog ("Realtime: SIMD kernels built for " + String (getSimdKernels().name));
+
+    if (lockAll)
+        lockMemory();
+    else
+        Logger::writeToLog ("Realtime: memory not locked, only the DSP chain's own buffers are");
+
+    for (int role = 0; role < numRoles; ++role)
+        if (schedules[(size_t) role].isUnchanged())
+            Logger::writeToLog ("Realtime: " + String (roleNames[role]) + " left with the default scheduling");
+
+    instance = this;
+    startTimer (logIntervalMs);
+}
+
+//==============================================================================
+void RealtimeSetup::applyToCurrentThread (Role role) noexcept
+{
+    auto* setup = instance.load();
+
+    if (setup == nullptr)
+        return;
+
+    const auto& schedule = setup->schedules[(size_t) role];
+
+    if (schedule.isUnchanged())
+        return;
+
+    auto policyError = 0, affinityError = 0;
+
+   #if JUCE_LINUX || JUCE_BSD || JUCE_MAC
+    if (schedule.policy != Schedule::unchanged)
+    {
+        const auto policy = schedule.policy == Schedule::fifo       ? SCHED_FIFO
+                          : schedule.policy == Schedule::roundRobin ? SCHED_RR
+                                                                    : SCHED_OTHER;
+        sched_param param {};
+        param.sched_priority = policy == SCHED_OTHER ? 0 : jlimit (sched_get_priority_min (policy),
+                                                                   sched_get_priority_max (policy),
+                                                                   schedule.priority);
+
+        policyError = pthread_setschedparam (pthread_self(), policy, &param);
+    }
+
+    if (schedule.cores != 0)
+    {
+       #if JUCE_LINUX
+        cpu_set_t set;
+        CPU_ZERO (&set);
+
+        for (int core = 0; core < 64; ++core)
+            if ((schedule.cores & ((uint64) 1 << core)) != 0)
+                CPU_SET (core, &set);
+
+        affinityError = pthread_setaffinity_np (pthread_self(), sizeof (set), &set);
+       #else
+        affinityError = ENOTSUP;
+       #endif
+    }
+   #elif JUCE_WINDOWS
+    // Windows has no fixed-priority policies, time critical is the closest it gets
+    if (schedule.policy != Schedule::unchanged)
+        policyError = SetThreadPriority (GetCurrentThread(), schedule.policy == Schedule::normal ? THREAD_PRIORITY_NORMAL
+                                                                                                 : THREAD_PRIORITY_TIME_CRITICAL)
+                        ? 0 : (int) GetLastError();
+
+    if (schedule.cores != 0)
+        affinityError = SetThreadAffinityMask (GetCurrentThread(), (DWORD_PTR) schedule.cores) != 0 ? 0 : (int) GetLastError();
+   #else
+    policyError = schedule.policy != Schedule::unchanged ? ENOTSUP : 0;
+    affinityError = schedule.cores != 0 ? ENOTSUP : 0;
+   #endif
+
+    // the first failure sticks, a later thread that got its settings doesn't hide it
+    auto noError = 0;
+
+    if (policyError != 0)
+        setup->firstPolicyErrors[(size_t) role].compare_exchange_strong (noError, policyError);
+
+    noError = 0;
+
+    if (affinityError != 0)
+        setup->firstAffinityErrors[(size_t) role].compare_exchange_strong (noError, affinityError);
+
+    if (policyError != 0 || affinityError != 0)
+        ++setup->numFailed[(size_t) role];
+
+    ++setup->numApplied[(size_t) role];
+}
+
+RealtimeSetup::Schedule RealtimeSetup::parseSchedule (const String& text)
+{
+    Schedule schedule;
+
+    const auto policyText = text.upToFirstOccurrenceOf ("@", false, false).trim();
+    const auto coresText = text.fromFirstOccurrenceOf ("@", false, false).trim();
+
+    const auto name = policyText.upToFirstOccurrenceOf (":", false, false).toLowerCase();
+
+    if (name == "fifo")           schedule.policy = Schedule::fifo;
+    else if (name == "rr")        schedule.policy = Schedule::roundRobin;
+    else if (name == "other")     schedule.policy = Schedule::normal;
+    else if (name.isNotEmpty())   return {};
+
+    schedule.priority = policyText.fromFirstOccurrenceOf (":", false, false).getIntValue();
+
+    for (const auto& range : StringArray::fromTokens (coresText, ",", {}))
+    {
+        const auto first = range.upToFirstOccurrenceOf ("-", false, false).getIntValue();
+        const auto last = range.containsChar ('-') ? range.fromFirstOccurrenceOf ("-", false, false).getIntValue() : first;
+
+        for (int core = jmax (0, first); core <= jmin (63, last); ++core)
+            schedule.cores |= (uint64) 1 << core;
+    }
+
+    return schedule;
+}
+
+//==============================================================================
+void RealtimeSetup::lockMemory()
+{
+   #if JUCE_LINUX || JUCE_BSD
+    // MCL_FUTURE also faults in every page that's mapped from now on, as it's mapped
+    if (mlockall (MCL_CURRENT | MCL_FUTURE) == 0)
+        Logger::writeToLog ("Realtime: all memory locked, and pages are faulted in as they're allocated");
+    else
+        Logger::writeToLog ("Realtime: memory could not be locked, " + describeError (errno));
+   #else
+    Logger::writeToLog ("Realtime: locking all memory isn't supported here, only the DSP chain's own buffers are locked");
+   #endif
+}
+
+void RealtimeSetup::timerCallback()
+{
+    // Keeps running rather than stopping once every role has been seen, as threads can
+    // apply their role again later: the audio thread does after a device change.
+    for (int role = 0; role < numRoles; ++role)
+    {
+        const auto applied = numApplied[(size_t) role].load();
+
+        if (applied == numLogged[(size_t) role])
+            continue;
+
+        numLogged[(size_t) role] = applied;
+
+        const auto& schedule = schedules[(size_t) role];
+        const auto policyError = firstPolicyErrors[(size_t) role].load();
+        const auto affinityError = firstAffinityErrors[(size_t) role].load();
+        const auto failed = numFailed[(size_t) role].load();
+
+        String result;
+
+        if (schedule.policy != Schedule::unchanged)
+            result << (policyError == 0 ? "got " : "did not get ") << describe (schedule)
+                   << (policyError == 0 ? String() : ", " + describeError (policyError));
+
+        if (schedule.cores != 0)
+        {
+            if (result.isNotEmpty())
+                result << "; ";
+
+            result << (affinityError == 0 ? "pinned" : "could not be pinned") << " to cores ";
+
+            StringArray cores;
+
+            for (int core = 0; core < 64; ++core)
+                if ((schedule.cores & ((uint64) 1 << core)) != 0)
+                    cores.add (String (core));
+
+            result << cores.joinIntoString (",")
+                   << (affinityError == 0 ? String() : ", " + describeError (affinityError));
+        }
+
+        result << " (" << (failed == 0 ? String() : "failed on " + String (failed) + " of ")
+               << applied << (applied == 1 ? " thread" : " threads") << " so far)";
+
+        Logger::writeToLog ("Realtime: " + String (roleNames[role]) + " " + result);
+    }
+}
+
+String RealtimeSetup::describe (const Schedule& schedule)
+{
+    switch (schedule.policy)
+    {
+        case Schedule::fifo:        return "SCHED_FIFO priority " + String (schedule.priority);
+        case Schedule::roundRobin:  return "SCHED_RR priority " + String (schedule.priority);
+        case Schedule::normal:      return "normal scheduling";
+        case Schedule::unchanged:   break;
+    }
+
+    return "unchanged scheduling";
+}
+
+String RealtimeSetup::describeError (int error)
+{
+   #if JUCE_LINUX || JUCE_BSD || JUCE_MAC
+    if (error == EPERM)
+        return "not permitted (raise the rtprio or memlock limit for this user)";
+
+    if (error == ENOMEM)
+        return "not enough allowed (raise the memlock limit)";
+
+    if (error == ENOTSUP)
+        return "not supported on this platform";
+
+    return String (std::strerror (error));
+   #else
+    return "error " + String (error);
+   #endif
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "EngineModules.h"
+
+/** Real-time scheduling, CPU affinity and memory locking for the player's threads, set on
+    the command line.
+
+    Every thread the player starts has a role, and each role can be given a scheduling
+    policy with a priority, and the cores it may run on:
+
+        --audio-thread=fifo:80@2 --worker-threads=fifo:70@3-5 --disk-threads=rr:10
+        --background-threads=@0,1 --lock-memory
+
+    A policy is fifo, rr or other, and cores are a list of numbers and ranges. Roles that
+    aren't mentioned are left as they are. --lock-memory locks the whole process into RAM,
+    including everything allocated later, so every buffer is faulted in when it's allocated
+    in prepare rather than on the audio thread.
+
+    Threads pick up their role's settings themselves, by calling applyToCurrentThread()
+    when they start. The OS can refuse any of it to a normal user, so what each role
+    actually got is logged: applying it only records the answer, and the message thread
+    looks for new answers a few times a second, for as long as the setup runs, so that a
+    thread that starts later, like a new audio thread after a device change, is logged
+    too. Without a running RealtimeSetup, nothing is changed.
+*/
+class RealtimeSetup final : private Timer
+{
+public:
+    enum Role
+    {
+        audioThread,
+        workerThreads,
+        diskThreads,
+        backgroundThreads,
+        numRoles
+    };
+
+    struct Schedule
+    {
+        enum Policy
+        {
+            unchanged,
+            normal,
+            fifo,
+            roundRobin
+        };
+
+        Policy policy = unchanged;
+        int priority = 0;
+
+        // a bit for each core the thread may run on, none leaves its affinity as it is
+        uint64 cores = 0;
+
+        bool isUnchanged() const noexcept       { return policy == unchanged && cores == 0; }
+    };
+
+    RealtimeSetup() = default;
+    ~RealtimeSetup() override;
+
+    /** Reads the settings, locks memory if asked to and logs what was granted. Call this
+        once, on the message thread, before any of the player's threads start.
+    */
+    void start (const String& commandLine);
+
+    /** Gives the calling thread its role's settings. Can be called from any thread, but the
+        system calls it makes can block, so the audio thread should only call it once, before
+        it starts processing.
+    */
+    static void applyToCurrentThread (Role role) noexcept;
+
+    /** Parses a setting like "fifo:80@2,4-6". Returns an unchanged one if it makes no sense. */
+    static Schedule parseSchedule (const String& text);
+
+private:
+    void timerCallback() override;
+    void lockMemory();
+    static String describe (const Schedule& schedule);
+    static String describeError (int error);
+
+    static constexpr int logIntervalMs = 250;
+
+    static inline std::atomic<RealtimeSetup*> instance { nullptr };
+
+    std::array<Schedule, numRoles> schedules {};
+
+    // the first error applying each role ran into, 0 until one did, and how many threads
+    // have applied it and how many of those failed
+    std::array<std::atomic<int>, numRoles> firstPolicyErrors {}, firstAffinityErrors {};
+    std::array<std::atomic<int>, numRoles> numApplied {}, numFailed {};
+
+    // message thread only: how many threads in each role had applied it when it was logged
+    std::array<int, numRoles> numLogged {};
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (RealtimeSetup)
+};
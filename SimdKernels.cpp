@@ -0,0 +1,71 @@
+#include "EngineModules.h"
+#include "SimdKernels.h"
+#include "SimdKernelsImpl.h"
+
+#if PLAYER_ENGINE_X86_KERNELS
+ #if JUCE_MSVC
+  #include <intrin.h>
+ #else
+  #include <cpuid.h>
+ #endif
+
+ extern const SimdKernels simdKernelsAVX2, simdKernelsAVX512;
+
+/*  CPUID says what the CPU can do, not whether the OS saves the wider registers on a context
+    switch. That's in XCR0, which can only be read once CPUID says the OS has set OSXSAVE.
+    AVX needs the SSE and AVX state (bits 1 and 2), and AVX-512 also needs the opmask and
+    upper ZMM state (bits 5 to 7).
+*/
+static uint64 getEnabledRegisterState() noexcept
+{
+   #if JUCE_MSVC
+    int info[4] {};
+    __cpuid (info, 1);
+    const auto ecx = (unsigned int) info[2];
+   #else
+    unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+
+    if (! __get_cpuid (1, &eax, &ebx, &ecx, &edx))
+        return 0;
+   #endif
+
+    constexpr unsigned int osxsave = 1u << 27;
+
+    if ((ecx & osxsave) == 0)
+        return 0;
+
+   #if JUCE_MSVC
+    return (uint64) _xgetbv (0);
+   #else
+    // spelt out rather than _xgetbv(), which would need -mxsave for this file
+    unsigned int low = 0, high = 0;
+    __asm__ volatile ("xgetbv" : "=a" (low), "=d" (high) : "c" (0));
+    return ((uint64) high << 32) | low;
+   #endif
+}
+#endif
+
+const SimdKernels& getSimdKernels() noexcept
+{
+    static const SimdKernels baseline { crossfade, hermite, measureLevel, "baseline" };
+
+    static const auto& best = []() -> const SimdKernels&
+    {
+       #if PLAYER_ENGINE_X86_KERNELS
+        constexpr uint64 avxState = 0x06, avx512State = avxState | 0xe0;
+        const auto enabledState = getEnabledRegisterState();
+        const auto osSavesAVX = (enabledState & avxState) == avxState;
+        const auto osSavesAVX512 = (enabledState & avx512State) == avx512State;
+
+        if (osSavesAVX512 && SystemStats::hasAVX512F())
+            return simdKernelsAVX512;
+
+        if (osSavesAVX && SystemStats::hasAVX2() && SystemStats::hasFMA3())
+            return simdKernelsAVX2;
+       #endif
+
+        return baseline;
+    }();
+
+    return best;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+
+/** The engine's hottest plain loops, built once for each instruction set we ship for.
+
+    The baseline build is what juce_recommended_config_flags targets. On x86 the same code is
+    compiled again in SimdKernels_AVX2.cpp and SimdKernels_AVX512.cpp with wider vector flags,
+    and getSimdKernels() hands out the best set the CPU supports, so one binary makes use of
+    whatever machine it lands on.
+
+    Keep this header free of JUCE: it's included by the files with the extra flags, and any
+    inline function they compile could be the copy the linker keeps for the whole program.
+*/
+struct SimdKernels
+{
+    /** Crossfades in place: wet[i] = dry[i] + (wet[i] - dry[i]) * ramp[i]. */
+    void (*crossfade) (float* wet, const float* dry, const float* ramp, int numSamples) noexcept;
+
+    /** Writes gain[i] times a 4-point Hermite interpolation of src at index[i] + frac[i].
+        src[index[i] - 1] to src[index[i] + 2] must all be readable.
+    */
+    void (*hermite) (float* dest, const float* src, const int* index, const float* frac,
+                     const float* gain, int numSamples) noexcept;
+
+    /** Finds the largest absolute value in src and the sum of its squares, in one pass. */
+    void (*measureLevel) (const float* src, int numSamples, float& peak, float& sumOfSquares) noexcept;
+
+    /** The instruction set these were built for, for logging. */
+    const char* name;
+};
+
+/** Returns the kernels for the best instruction set this CPU has. They're picked on the
+    first call, so make that from the message thread rather than the audio thread.
+*/
+const SimdKernels& getSimdKernels() noexcept;
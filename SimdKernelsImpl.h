@@ -0,0 +1,69 @@
+// The bodies of the SimdKernels, included once by each file that builds them for an
+// instruction set. Everything in here must be plain C++ with no includes, and stays in an
+// anonymous namespace so that every build of it is private to its own file.
+
+namespace
+{
+    void crossfade (float* wet, const float* dry, const float* ramp, int numSamples) noexcept
+    {
+        for (int i = 0; i < numSamples; ++i)
+            wet[i] = dry[i] + (wet[i] - dry[i]) * ramp[i];
+    }
+
+    void hermite (float* dest, const float* src, const int* index, const float* frac,
+                  const float* gain, int numSamples) noexcept
+    {
+        for (int i = 0; i < numSamples; ++i)
+        {
+            const auto* x = src + index[i] - 1;
+            const auto t = frac[i];
+
+            // 4-point, 3rd-order Hermite
+            const auto c1 = 0.5f * (x[2] - x[0]);
+            const auto c2 = x[0] - 2.5f * x[1] + 2.0f * x[2] - 0.5f * x[3];
+            const auto c3 = 0.5f * (x[3] - x[0]) + 1.5f * (x[1] - x[2]);
+
+            dest[i] = gain[i] * (((c3 * t + c2) * t + c1) * t + x[1]);
+        }
+    }
+
+    void measureLevel (const float* src, int numSamples, float& peak, float& sumOfSquares) noexcept
+    {
+        // independent accumulators, one per lane of the widest vector we build for, so the
+        // compiler can keep them in a register without having to reorder a float sum
+        constexpr int lanes = 16;
+        float peaks[lanes] = {}, sums[lanes] = {};
+
+        auto i = 0;
+
+        for (; i + lanes <= numSamples; i += lanes)
+        {
+            for (int lane = 0; lane < lanes; ++lane)
+            {
+                const auto x = src[i + lane];
+                const auto magnitude = x < 0.0f ? -x : x;
+
+                peaks[lane] = magnitude > peaks[lane] ? magnitude : peaks[lane];
+                sums[lane] += x * x;
+            }
+        }
+
+        for (; i < numSamples; ++i)
+        {
+            const auto x = src[i];
+            const auto magnitude = x < 0.0f ? -x : x;
+
+            peaks[0] = magnitude > peaks[0] ? magnitude : peaks[0];
+            sums[0] += x * x;
+        }
+
+        peak = 0.0f;
+        sumOfSquares = 0.0f;
+
+        for (int lane = 0; lane < lanes; ++lane)
+        {
+            peak = peaks[lane] > peak ? peaks[lane] : peak;
+            sumOfSquares += sums[lane];
+        }
+    }
+}
@@ -0,0 +1,12 @@
+// Built with AVX2 and FMA enabled, see CMakeLists.txt. Nothing but SimdKernels.h may be included here.
+
+#include "SimdKernels.h"
+
+#if PLAYER_ENGINE_X86_KERNELS
+
+#include "SimdKernelsImpl.h"
+
+extern const SimdKernels simdKernelsAVX2;
+const SimdKernels simdKernelsAVX2 { crossfade, hermite, measureLevel, "AVX2" };
+
+#endif
@@ -0,0 +1,12 @@
+// Built with AVX-512 enabled, see CMakeLists.txt. Nothing but SimdKernels.h may be included here.
+
+#include "SimdKernels.h"
+
+#if PLAYER_ENGINE_X86_KERNELS
+
+#include "SimdKernelsImpl.h"
+
+extern const SimdKernels simdKernelsAVX512;
+const SimdKernels simdKernelsAVX512 { crossfade, hermite, measureLevel, "AVX-512" };
+
+#endif
@@ -0,0 +1,125 @@
+#include "SpectrumAnalyser.h"
+#include "RealtimeSetup.h"
+
+SpectrumAnalyser::SpectrumAnalyser (int maxNumChannels)
+    : Thread ("Spectrum Analyser"),
+      ring (jmax (1, maxNumChannels), fftSize * 4),
+      history ((size_t) fftSize, 0.0f),
+      frame ((size_t) fftSize * 2, 0.0f)
+{
+    levels.fill (minimumDecibels);
+    latest.fill (minimumDecibels);
+
+    startThread (Priority::low);
+}
+
+SpectrumAnalyser::~SpectrumAnalyser()
+{
+    stopThread (1000);
+}
+
+void SpectrumAnalyser::prepare (double newSampleRate, int newNumChannels) noexcept
+{
+    sampleRate = newSampleRate;
+    numChannels = jlimit (1, ring.getNumChannels(), newNumChannels);
+}
+
+void SpectrumAnalyser::pushSamples (const AudioBuffer<float>& buffer, int startSample, int numSamples) noexcept
+{
+    const auto channels = jmin (buffer.getNumChannels(), numChannels.load (std::memory_order_relaxed));
+
+    // a block that doesn't fit is dropped, the audio thread never waits for the reader
+    if (fifo.getFreeSpace() < numSamples)
+        return;
+
+    const auto scope = fifo.write (numSamples);
+
+    for (int ch = 0; ch < channels; ++ch)
+    {
+        if (scope.blockSize1 > 0)
+            ring.copyFrom (ch, scope.startIndex1, buffer, ch, startSample, scope.blockSize1);
+
+        if (scope.blockSize2 > 0)
+            ring.copyFrom (ch, scope.startIndex2, buffer, ch, startSample + scope.blockSize1, scope.blockSize2);
+    }
+
+    for (int ch = channels; ch < numChannels.load (std::memory_order_relaxed); ++ch)
+    {
+        if (scope.blockSize1 > 0)
+            ring.clear (ch, scope.startIndex1, scope.blockSize1);
+
+        if (scope.blockSize2 > 0)
+            ring.clear (ch, scope.startIndex2, scope.blockSize2);
+    }
+}
+
+bool SpectrumAnalyser::getLatestSpectrum (std::array<float, numBins>& dest)
+{
+    if (! hasNewFrame.exchange (false))
+        return false;
+
+    const SpinLock::ScopedLockType sl (latestLock);
+    dest = latest;
+    return true;
+}
+
+//==============================================================================
+void SpectrumAnalyser::run()
+{
+    RealtimeSetup::applyToCurrentThread (RealtimeSetup::backgroundThreads);
+
+    while (! threadShouldExit())
+    {
+        while (fifo.getNumReady() >= hopSize && ! threadShouldExit())
+            processHop();
+
+        // the audio thread doesn't signal, waking a thread isn't something it can afford
+        wait (10);
+    }
+}
+
+void SpectrumAnalyser::processHop()
+{
+    const auto channels = numChannels.load();
+    const auto gain = 1.0f / (float) channels;
+
+    // slide the window along by a hop and mix the new samples down onto the end of it
+    std::move (history.begin() + hopSize, history.end(), history.begin());
+    auto* hop = history.data() + fftSize - hopSize;
+    std::fill (hop, hop + hopSize, 0.0f);
+
+    {
+        const auto scope = fifo.read (hopSize);
+
+        for (int ch = 0; ch < channels; ++ch)
+        {
+            if (scope.blockSize1 > 0)
+                FloatVectorOperations::addWithMultiply (hop, ring.getReadPointer (ch, scope.startIndex1), gain, scope.blockSize1);
+
+            if (scope.blockSize2 > 0)
+                FloatVectorOperations::addWithMultiply (hop + scope.blockSize1, ring.getReadPointer (ch, scope.startIndex2), gain, scope.blockSize2);
+        }
+    }
+
+    std::copy (history.begin(), history.end(), frame.begin());
+    window.multiplyWithWindowingTable (frame.data(), (size_t) fftSize);
+    fft.performFrequencyOnlyForwardTransform (frame.data(), true);
+
+    // a full-scale sine comes out at a quarter of the frame size once the Hann window has
+    // halved it, so that's 0 dB
+    const auto scale = 4.0f / (float) fftSize;
+    const auto decay = decayDecibelsPerSecond * (float) hopSize / (float) sampleRate.load();
+
+    for (int bin = 0; bin < numBins; ++bin)
+    {
+        const auto level = Decibels::gainToDecibels (frame[(size_t) bin] * scale, minimumDecibels);
+        levels[(size_t) bin] = jmax (level, levels[(size_t) bin] - decay);
+    }
+
+    {
+        const SpinLock::ScopedLockType sl (latestLock);
+        latest = levels;
+    }
+
+    hasNewFrame = true;
+}
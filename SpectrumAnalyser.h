@@ -0,0 +1,64 @@
+#pragma once
+
+#include "EngineModules.h"
+
+/** Works out the spectrum of what's being played, away from the audio thread.
+
+    The audio thread copies its output into a single-producer, single-consumer ring and
+    that's all it does; if the ring is full the block is dropped rather than waited for.
+    A background thread takes the samples out a hop at a time, mixes them down to mono
+    and runs a Hann-windowed FFT over the last fftSize of them, so consecutive frames
+    overlap by three quarters. The magnitudes are kept in dB with a falloff, and the
+    latest set can be picked up from any thread other than the audio thread.
+*/
+class SpectrumAnalyser final : private Thread
+{
+public:
+    static constexpr int fftOrder = 11;
+    static constexpr int fftSize = 1 << fftOrder;
+    static constexpr int numBins = fftSize / 2;
+    static constexpr int hopSize = fftSize / 4;
+
+    static constexpr float minimumDecibels = -100.0f;
+
+    explicit SpectrumAnalyser (int maxNumChannels);
+    ~SpectrumAnalyser() override;
+
+    /** Can be called from the audio thread, as long as it isn't pushing at the same time. */
+    void prepare (double sampleRate, int numChannels) noexcept;
+
+    /** Copies a block of output into the ring. Called on the audio thread, and never blocks. */
+    void pushSamples (const AudioBuffer<float>& buffer, int startSample, int numSamples) noexcept;
+
+    /** Copies the latest levels, one per bin in dB, if there's been a new frame since the last
+        call. Returns false, leaving dest alone, if there hasn't.
+    */
+    bool getLatestSpectrum (std::array<float, numBins>& dest);
+
+    double getSampleRate() const noexcept       { return sampleRate; }
+
+private:
+    void run() override;
+    void processHop();
+
+    static constexpr float decayDecibelsPerSecond = 60.0f;
+
+    // the ring holds a few frames, so the background thread has plenty of time to catch up
+    AbstractFifo fifo { fftSize * 4 };
+    AudioBuffer<float> ring;
+
+    std::atomic<double> sampleRate { 44100.0 };
+    std::atomic<int> numChannels { 2 };
+
+    // background thread only
+    dsp::FFT fft { fftOrder };
+    dsp::WindowingFunction<float> window { (size_t) fftSize, dsp::WindowingFunction<float>::hann, false };
+    std::vector<float> history, frame;
+    std::array<float, numBins> levels;
+
+    SpinLock latestLock;
+    std::array<float, numBins> latest;
+    std::atomic<bool> hasNewFrame { false };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SpectrumAnalyser)
+};
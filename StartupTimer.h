@@ -0,0 +1,79 @@
+#pragma once
+
+#include "EngineModules.h"
+
+/** Measures how long the app takes to come up.
+
+    The clock starts in JUCEApplication::initialise(), and each milestone is logged once,
+    with the time since then, the first time it is reached. Milestones can be marked from
+    any thread, including the audio thread: marking one only stores a timestamp, and the
+    logging happens later on the message thread. Without a running StartupTimer, marking
+    does nothing.
+*/
+class StartupTimer final : private AsyncUpdater
+{
+public:
+    enum Milestone
+    {
+        firstPaint,
+        deviceOpened,
+        firstAudioCallback,
+        numMilestones
+    };
+
+    StartupTimer() = default;
+
+    ~StartupTimer() override
+    {
+        instance = nullptr;
+        cancelPendingUpdate();
+    }
+
+    /** Starts the clock. Call this once, on the message thread. */
+    void start()
+    {
+        startTime = Time::getMillisecondCounterHiRes();
+        instance = this;
+    }
+
+    static void mark (Milestone milestone) noexcept
+    {
+        auto* timer = instance.load();
+
+        // checked before the exchange, so that the audio thread only ever reads the flag
+        if (timer == nullptr
+             || timer->claimed[milestone].load (std::memory_order_relaxed)
+             || timer->claimed[milestone].exchange (true))
+            return;
+
+        // the time is written before the milestone is published, so it's there to be logged
+        timer->times[milestone].store (Time::getMillisecondCounterHiRes() - timer->startTime, std::memory_order_relaxed);
+        timer->reached[milestone].store (true, std::memory_order_release);
+        timer->triggerAsyncUpdate();
+    }
+
+private:
+    void handleAsyncUpdate() override
+    {
+        static const char* const names[] = { "first paint", "audio device open", "first audio callback" };
+
+        for (int i = 0; i < numMilestones; ++i)
+        {
+            if (! logged[i] && reached[i].load (std::memory_order_acquire))
+            {
+                logged[i] = true;
+                Logger::writeToLog ("Startup: " + String (names[i]) + " after "
+                                     + String (times[i].load (std::memory_order_relaxed), 1) + " ms");
+            }
+        }
+    }
+
+    static inline std::atomic<StartupTimer*> instance { nullptr };
+
+    double startTime = 0.0;
+    std::atomic<bool> claimed[numMilestones] {}, reached[numMilestones] {};
+    std::atomic<double> times[numMilestones] {};
+    bool logged[numMilestones] {};
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (StartupTimer)
+};
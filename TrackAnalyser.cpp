@@ -0,0 +1,419 @@
+#include "TrackAnalyser.h"
+#include "InputSources.h"
+#include "RealtimeSetup.h"
+
+String TrackAnalysis::getKeyName (int pitchClass, bool minor)
+{
+    static const char* const names[] = { "C", "C#", "D", "Eb", "E", "F", "F#", "G", "Ab", "A", "Bb", "B" };
+
+    if (! isPositiveAndBelow (pitchClass, 12))
+        return {};
+
+    return String (names[pitchClass]) + (minor ? " minor" : " major");
+}
+
+//==============================================================================
+TrackAnalyser::TrackAnalyser (AudioFormatManager& afm)
+    : Thread ("Track Analyser"),
+      formatManager (afm),
+      pool (jmax (1, SystemStats::getNumCpus() - 1), 0, Thread::Priority::low)
+{
+    startThread (Priority::low);
+}
+
+TrackAnalyser::~TrackAnalyser()
+{
+    signalThreadShouldExit();
+    notify();
+    stopThread (10000);
+}
+
+void TrackAnalyser::analyse (const URL& url, Callback onDone)
+{
+    const auto source = makeInputSource (url);
+
+    if (source == nullptr)
+        return;
+
+    std::optional<TrackAnalysis> cached;
+
+    {
+        const ScopedLock sl (lock);
+        const auto hash = source->hashCode();
+
+        if (cache.contains (hash))
+        {
+            cached = cache[hash];
+        }
+        else
+        {
+            pendingURL = url;
+            pendingCallback = std::move (onDone);
+        }
+    }
+
+    if (! cached.has_value())
+        notify();
+    else if (onDone != nullptr)
+        onDone (url, *cached);
+}
+
+void TrackAnalyser::run()
+{
+    RealtimeSetup::applyToCurrentThread (RealtimeSetup::backgroundThreads);
+
+    while (! threadShouldExit())
+    {
+        URL url;
+        Callback onDone;
+
+        {
+            const ScopedLock sl (lock);
+            url = std::exchange (pendingURL, URL());
+            onDone = std::exchange (pendingCallback, nullptr);
+        }
+
+        if (url.isEmpty())
+        {
+            wait (-1);
+            continue;
+        }
+
+        const auto source = makeInputSource (url);
+        auto stream = source != nullptr ? rawToUniquePtr (source->createInputStream()) : nullptr;
+        auto reader = stream != nullptr ? rawToUniquePtr (formatManager.createReaderFor (std::move (stream))) : nullptr;
+
+        if (reader == nullptr)
+            continue;
+
+        const auto analysis = analyseReader (*reader, pool, [this] { return threadShouldExit(); });
+
+        if (threadShouldExit())
+            return;
+
+        {
+            const ScopedLock sl (lock);
+            const auto hash = source->hashCode();
+
+            // a few bytes each, so this only keeps the oldest out of the way
+            cache.set (hash, analysis);
+            cacheOrder.removeFirstMatchingValue (hash);
+            cacheOrder.add (hash);
+
+            while (cacheOrder.size() > maxCachedFiles)
+                cache.remove (cacheOrder.removeAndReturn (0));
+        }
+
+        if (onDone != nullptr)
+            MessageManager::callAsync ([onDone, url, analysis] { onDone (url, analysis); });
+    }
+}
+
+//==============================================================================
+namespace
+{
+    // Autocorrelation of the onset envelope, weighted towards 120 bpm so that a piece isn't
+    // read at half or double its tempo unless that's clearly stronger.
+    double findTempo (const std::vector<float>& onsets, double frameRate)
+    {
+        constexpr double minBpm = 60.0, maxBpm = 200.0;
+
+        const auto minLag = (int) std::floor (frameRate * 60.0 / maxBpm);
+        const auto maxLag = (int) std::ceil (frameRate * 60.0 / minBpm);
+        const auto numFrames = (int) onsets.size();
+
+        if (numFrames < maxLag * 4)
+            return 0.0;
+
+        std::vector<double> scores ((size_t) maxLag + 2, 0.0);
+
+        for (int lag = minLag; lag <= maxLag + 1; ++lag)
+        {
+            double sum = 0.0;
+
+            for (int i = lag; i < numFrames; ++i)
+                sum += (double) onsets[(size_t) i] * onsets[(size_t) (i - lag)];
+
+            const auto bpm = 60.0 * frameRate / lag;
+            const auto octaves = std::log2 (bpm / 120.0);
+            scores[(size_t) lag] = sum / (numFrames - lag) * std::exp (-0.5 * octaves * octaves);
+        }
+
+        auto best = minLag;
+
+        for (int lag = minLag + 1; lag <= maxLag; ++lag)
+            if (scores[(size_t) lag] > scores[(size_t) best])
+                best = lag;
+
+        if (scores[(size_t) best] <= 0.0)
+            return 0.0;
+
+        // the peak lies between frames, a parabola through its neighbours finds where
+        auto lag = (double) best;
+
+        if (best > minLag)
+        {
+            const auto a = scores[(size_t) best - 1], b = scores[(size_t) best], c = scores[(size_t) best + 1];
+            const auto denominator = a - 2.0 * b + c;
+
+            if (denominator < 0.0)
+                lag += jlimit (-0.5, 0.5, 0.5 * (a - c) / denominator);
+        }
+
+        return 60.0 * frameRate / lag;
+    }
+
+    // Pearson correlation of the chroma with each rotation of the Krumhansl-Kessler profiles.
+    void findKey (const std::array<double, 12>& chroma, TrackAnalysis& result)
+    {
+        static constexpr double major[] = { 6.35, 2.23, 3.48, 2.33, 4.38, 4.09, 2.52, 5.19, 2.39, 3.66, 2.29, 2.88 };
+        static constexpr double minor[] = { 6.33, 2.68, 3.52, 5.38, 2.60, 3.53, 2.54, 4.75, 3.98, 2.69, 3.34, 3.17 };
+
+        const auto correlate = [&chroma] (const double* profile, int tonic)
+        {
+            double meanX = 0.0, meanY = 0.0;
+
+            for (int i = 0; i < 12; ++i)
+            {
+                meanX += chroma[(size_t) i];
+                meanY += profile[i];
+            }
+
+            meanX /= 12.0;
+            meanY /= 12.0;
+
+            double xy = 0.0, xx = 0.0, yy = 0.0;
+
+            for (int i = 0; i < 12; ++i)
+            {
+                const auto x = chroma[(size_t) ((tonic + i) % 12)] - meanX;
+                const auto y = profile[i] - meanY;
+
+                xy += x * y;
+                xx += x * x;
+                yy += y * y;
+            }
+
+            return xx > 0.0 ? xy / std::sqrt (xx * yy) : 0.0;
+        };
+
+        auto bestScore = 0.0;
+
+        for (int tonic = 0; tonic < 12; ++tonic)
+        {
+            for (const auto isMinor : { false, true })
+            {
+                const auto score = correlate (isMinor ? minor : major, tonic);
+
+                if (score > bestScore)
+                {
+                    bestScore = score;
+                    result.keyPitchClass = tonic;
+                    result.minor = isMinor;
+                }
+            }
+        }
+    }
+}
+
+TrackAnalysis TrackAnalyser::analyseReader (AudioFormatReader& reader, ThreadPool& pool,
+                                            const std::function<bool()>& shouldExit)
+{
+    const auto exitRequested = [&] { return shouldExit != nullptr && shouldExit(); };
+
+    if (reader.sampleRate <= 0.0 || reader.numChannels == 0)
+        return {};
+
+    // Mix down to mono and decimate. Nothing above a few kHz matters for either onsets or
+    // pitch, and it cuts the number of FFTs by the same factor.
+    const auto decimation = jmax (1, (int) (reader.sampleRate / analysisRate));
+    const auto rate = reader.sampleRate / decimation;
+    const auto length = jmin (reader.lengthInSamples, (int64) (maxSeconds * reader.sampleRate));
+
+    // A low-pass runs first, or whatever is above the new Nyquist frequency folds down into
+    // the chroma band. It's flat to 0.4 of the new rate and 70 dB down from 0.55 of it, so
+    // what's left to alias lands above 0.45 of it, well clear of the band's 2 kHz top.
+    std::vector<float> taps { 1.0f };
+
+    if (decimation > 1)
+    {
+        const auto lowPass = dsp::FilterDesign<float>::designFIRLowpassKaiserMethod ((float) (0.475 * rate), reader.sampleRate,
+                                                                                   (float) (0.15 * rate / reader.sampleRate), -70.0f);
+        const auto* coefficients = lowPass->getRawCoefficients();
+        taps.assign (coefficients, coefficients + lowPass->getFilterOrder() + 1);
+    }
+
+    const auto history = (int) taps.size() - 1;
+
+    std::vector<float> mono;
+    mono.reserve ((size_t) (length / decimation + 1));
+
+    {
+        const auto chunkSize = 8192 * decimation;
+        AudioBuffer<float> chunk ((int) reader.numChannels, chunkSize);
+        const auto gain = 1.0f / (float) reader.numChannels;
+
+        // the last samples of the previous chunk that the filter still reaches back to,
+        // then the current chunk mixed down
+        std::vector<float> input ((size_t) history, 0.0f);
+
+        // the filter is only worked out at the samples that are kept
+        int64 nextKept = 0;
+
+        for (int64 position = 0; position < length; position += chunkSize)
+        {
+            if (exitRequested())
+                return {};
+
+            const auto num = (int) jmin ((int64) chunkSize, length - position);
+            reader.read (&chunk, 0, num, position, true, true);
+
+            input.resize ((size_t) (history + num));
+            FloatVectorOperations::copyWithMultiply (input.data() + history, chunk.getReadPointer (0), gain, num);
+
+            for (int ch = 1; ch < chunk.getNumChannels(); ++ch)
+                FloatVectorOperations::addWithMultiply (input.data() + history, chunk.getReadPointer (ch), gain, num);
+
+            for (; nextKept < position + num; nextKept += decimation)
+            {
+                const auto* newest = input.data() + history + (nextKept - position);
+                auto sum = 0.0f;
+
+                for (int j = 0; j <= history; ++j)
+                    sum += taps[(size_t) j] * newest[-j];
+
+                mono.push_back (sum);
+            }
+
+            std::copy (input.end() - history, input.end(), input.begin());
+        }
+    }
+
+    const auto numFrames = (int) mono.size() >= fftSize ? ((int) mono.size() - fftSize) / hopSize + 1 : 0;
+
+    if (numFrames < 2)
+        return {};
+
+    // Each job takes a run of frames with an FFT of its own. It works out the frame before
+    // its run as well, so the flux at the first frame of every run is still right.
+    const auto numJobs = jmin (numFrames, jmax (1, pool.getNumThreads()) * 4);
+    const auto framesPerJob = (numFrames + numJobs - 1) / numJobs;
+
+    std::vector<float> onsets ((size_t) numFrames, 0.0f);
+    std::vector<std::array<double, 12>> chromas ((size_t) numJobs);
+
+    // the pitch class of every bin, or -1 for bins outside the range that's useful for the key
+    std::vector<int> binPitchClass ((size_t) fftSize / 2, -1);
+
+    for (int bin = 1; bin < fftSize / 2; ++bin)
+    {
+        const auto frequency = bin * rate / fftSize;
+
+        if (frequency >= 100.0 && frequency <= 2000.0)
+        {
+            const auto note = roundToInt (69.0 + 12.0 * std::log2 (frequency / 440.0));
+            binPitchClass[(size_t) bin] = ((note % 12) + 12) % 12;
+        }
+    }
+
+    std::atomic<int> jobsRemaining { numJobs };
+    WaitableEvent allDone;
+
+    for (int job = 0; job < numJobs; ++job)
+    {
+        pool.addJob ([&, job]
+        {
+            // the pool's threads do background work too, each one picks up the role once
+            thread_local auto roleApplied = false;
+
+            if (! std::exchange (roleApplied, true))
+                RealtimeSetup::applyToCurrentThread (RealtimeSetup::backgroundThreads);
+
+            const auto first = job * framesPerJob;
+            const auto last = jmin (numFrames, first + framesPerJob);
+
+            dsp::FFT fft (fftOrder);
+            dsp::WindowingFunction<float> window ((size_t) fftSize, dsp::WindowingFunction<float>::hann, false);
+            std::vector<float> frame ((size_t) fftSize * 2), previous ((size_t) fftSize / 2, 0.0f);
+            auto& chroma = chromas[(size_t) job];
+            chroma.fill (0.0);
+
+            const auto transform = [&] (int index)
+            {
+                std::fill (frame.begin(), frame.end(), 0.0f);
+                std::copy_n (mono.begin() + index * hopSize, fftSize, frame.begin());
+                window.multiplyWithWindowingTable (frame.data(), (size_t) fftSize);
+                fft.performFrequencyOnlyForwardTransform (frame.data(), true);
+            };
+
+            if (first > 0)
+            {
+                transform (first - 1);
+
+                for (int bin = 0; bin < fftSize / 2; ++bin)
+                    previous[(size_t) bin] = std::log1p (100.0f * frame[(size_t) bin]);
+            }
+
+            for (int index = first; index < last && ! exitRequested(); ++index)
+            {
+                transform (index);
+
+                auto flux = 0.0f;
+
+                for (int bin = 0; bin < fftSize / 2; ++bin)
+                {
+                    const auto magnitude = frame[(size_t) bin];
+                    const auto compressed = std::log1p (100.0f * magnitude);
+
+                    if (index > 0)
+                        flux += jmax (0.0f, compressed - previous[(size_t) bin]);
+
+                    previous[(size_t) bin] = compressed;
+
+                    if (const auto pitchClass = binPitchClass[(size_t) bin]; pitchClass >= 0)
+                        chroma[(size_t) pitchClass] += (double) magnitude * magnitude;
+                }
+
+                onsets[(size_t) index] = flux;
+            }
+
+            if (--jobsRemaining == 0)
+                allDone.signal();
+        });
+    }
+
+    allDone.wait();
+
+    if (exitRequested())
+        return {};
+
+    // Take away the local average, so that only the onsets that stand out from what's
+    // around them count, then keep the rises.
+    const auto frameRate = rate / hopSize;
+    const auto averageLength = jmax (1, roundToInt (frameRate * 0.5));
+    std::vector<float> envelope ((size_t) numFrames, 0.0f);
+    double runningSum = 0.0;
+
+    for (int i = 0; i < numFrames; ++i)
+    {
+        runningSum += onsets[(size_t) i];
+
+        if (i >= averageLength)
+            runningSum -= onsets[(size_t) (i - averageLength)];
+
+        const auto average = runningSum / jmin (i + 1, averageLength);
+        envelope[(size_t) i] = jmax (0.0f, onsets[(size_t) i] - (float) average);
+    }
+
+    TrackAnalysis result;
+    result.bpm = findTempo (envelope, frameRate);
+
+    std::array<double, 12> chroma {};
+
+    for (const auto& partial : chromas)
+        for (size_t i = 0; i < chroma.size(); ++i)
+            chroma[i] += partial[i];
+
+    findKey (chroma, result);
+    return result;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "EngineModules.h"
+
+/** The tempo and key found in a file. */
+struct TrackAnalysis
+{
+    /** Beats per minute, or 0 if no tempo was found. */
+    double bpm = 0.0;
+
+    /** The key's tonic as a pitch class, 0 for C up to 11 for B, or -1 if no key was found. */
+    int keyPitchClass = -1;
+    bool minor = false;
+
+    bool hasTempo() const noexcept      { return bpm > 0.0; }
+    bool hasKey() const noexcept        { return keyPitchClass >= 0; }
+
+    /** Returns the pitch class of the major key that has the same notes, which is the key
+        itself unless it's minor.
+    */
+    int getRelativeMajorPitchClass() const noexcept     { return minor ? (keyPitchClass + 3) % 12 : keyPitchClass; }
+
+    static String getKeyName (int pitchClass, bool minor);
+};
+
+//==============================================================================
+/** Finds the tempo and key of files in the background, once per file.
+
+    The file is mixed down to mono, low-pass filtered and decimated to around 11 kHz, then
+    cut into overlapping Hann-windowed FFT frames, which are shared out over a thread pool.
+    The spectral flux between frames gives an onset envelope whose autocorrelation, weighted
+    towards moderate tempos, gives the tempo. The frames' energy folded into pitch classes
+    gives a chroma profile, which is matched against the Krumhansl-Kessler key profiles.
+
+    Results are cached under the same hash as the file's thumbnail, so asking again for a
+    file that's been seen before answers straight away.
+*/
+class TrackAnalyser final : private Thread
+{
+public:
+    explicit TrackAnalyser (AudioFormatManager& formatManager);
+    ~TrackAnalyser() override;
+
+    using Callback = std::function<void (const URL&, const TrackAnalysis&)>;
+
+    /** Analyses a file and calls onDone with the result on the message thread. A file that's
+        been analysed before is answered from the cache before this returns. If another file
+        is asked for before this one gets started, only the latest is analysed.
+    */
+    void analyse (const URL& url, Callback onDone);
+
+    /** Does the actual work on the calling thread, spreading the FFT frames over the pool. */
+    static TrackAnalysis analyseReader (AudioFormatReader& reader, ThreadPool& pool,
+                                        const std::function<bool()>& shouldExit = nullptr);
+
+private:
+    void run() override;
+
+    static constexpr double analysisRate = 11025.0;
+    static constexpr double maxSeconds = 300.0;
+    static constexpr int fftOrder = 11;
+    static constexpr int fftSize = 1 << fftOrder;
+    static constexpr int hopSize = 128;
+    static constexpr int maxCachedFiles = 64;
+
+    AudioFormatManager& formatManager;
+    ThreadPool pool;
+
+    CriticalSection lock;
+    URL pendingURL;
+    Callback pendingCallback;
+
+    HashMap<int64, TrackAnalysis> cache;
+    Array<int64> cacheOrder;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (TrackAnalyser)
+};
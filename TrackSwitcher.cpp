@@ -0,0 +1,741 @@
+#include "TrackSwitcher.h"
+#include "InputSources.h"
+#include "RealtimeSetup.h"
+
+TrackSwitcher::TrackSwitcher (AudioFormatManager& afm, TimeSliceThread& thread, int numTracksToPreload)
+    : Thread ("Track Loader"),
+      formatManager (afm),
+      readAheadThread (thread),
+      numToPreload (jmax (0, numTracksToPreload)),
+      queuedFifo (numToPreload + 4)
+{
+    // the playing track, one fading out, one waiting to be swapped in, one the message
+    // thread may still hold as its current track, plus the preloaded ones
+    const auto numTracks = numToPreload + 4;
+
+    for (int i = 0; i < numTracks; ++i)
+        tracks.add (new Track());
+
+    queuedTracks.resize ((size_t) queuedFifo.getTotalSize(), nullptr);
+
+    startThread();
+}
+
+TrackSwitcher::~TrackSwitcher()
+{
+    cancelPendingUpdate();
+    stopThread (4000);
+}
+
+//==============================================================================
+void TrackSwitcher::loadAsync (const URL& url, bool startPlaying, std::function<void (bool)> onLoaded)
+{
+    {
+        const ScopedLock sl (requestLock);
+        pendingRequest.reset (new LoadRequest { url, startPlaying, std::move (onLoaded) });
+    }
+
+    notify();
+}
+
+void TrackSwitcher::setQueue (const Array<URL>& urls)
+{
+    {
+        const ScopedLock sl (requestLock);
+
+        // anything preloaded from the previous queue is dropped by the audio thread
+        firstValidQueueId = nextQueueId;
+        lastPreloadedId = nextQueueId - 1;
+
+        queue.clearQuick();
+
+        for (auto& url : urls)
+            queue.add ({ url, nextQueueId++ });
+    }
+
+    notify();
+}
+
+Array<URL> TrackSwitcher::getQueue() const
+{
+    const ScopedLock sl (requestLock);
+    const auto lastStarted = lastStartedQueueId.load();
+
+    Array<URL> urls;
+
+    for (auto& entry : queue)
+        if (entry.id > lastStarted)
+            urls.add (entry.url);
+
+    return urls;
+}
+
+void TrackSwitcher::setCrossfadeLength (double seconds) noexcept
+{
+    crossfadeSeconds = jmax (0.0, seconds);
+}
+
+void TrackSwitcher::setLooping (bool shouldLoop)
+{
+    looping = shouldLoop;
+
+    {
+        const ScopedLock sl (prepareLock);
+
+        for (auto* track : tracks)
+            if (track->readerSource != nullptr)
+                track->readerSource->setLooping (shouldLoop);
+    }
+}
+
+void TrackSwitcher::setLoopRegion (Range<double> regionInSeconds)
+{
+    {
+        const ScopedLock sl (prepareLock);
+
+        if (currentTrack != nullptr && currentTrack->readerSource != nullptr)
+        {
+            const auto rate = currentTrack->reader->sampleRate;
+
+            currentTrack->readerSource->setLoopRegion ({ (int64) (regionInSeconds.getStart() * rate),
+                                                        (int64) (regionInSeconds.getEnd() * rate) });
+        }
+    }
+}
+
+void TrackSwitcher::setPosition (double seconds) noexcept
+{
+    pendingSeek = jmax (0.0, seconds);
+}
+
+void TrackSwitcher::beginScrub() noexcept
+{
+    scrubTarget = playPosition.load();
+    scrubbing = true;
+}
+
+AudioTransportSource* TrackSwitcher::getCurrentTransport() const noexcept
+{
+    return currentTrack != nullptr ? &currentTrack->transport : nullptr;
+}
+
+URL TrackSwitcher::getCurrentURL() const
+{
+    return currentTrack != nullptr ? currentTrack->url : URL();
+}
+
+void TrackSwitcher::addTransportListener (ChangeListener* listener)
+{
+    for (auto* track : tracks)
+        track->transport.addChangeListener (listener);
+}
+
+void TrackSwitcher::removeTransportListener (ChangeListener* listener)
+{
+    for (auto* track : tracks)
+        track->transport.removeChangeListener (listener);
+}
+
+//==============================================================================
+void TrackSwitcher::prepareToPlay (int samplesPerBlockExpected, double newSampleRate)
+{
+    const ScopedLock sl (prepareLock);
+
+    blockSize = samplesPerBlockExpected;
+    sampleRate = newSampleRate;
+    isPrepared = true;
+
+    fadeBuffer.setSize (maxNumChannels, samplesPerBlockExpected, false, false, true);
+    scrubber.prepare (newSampleRate, samplesPerBlockExpected, maxNumChannels);
+
+    for (auto* track : tracks)
+        if (track->readerSource != nullptr)
+            track->transport.prepareToPlay (samplesPerBlockExpected, newSampleRate);
+}
+
+void TrackSwitcher::releaseResources()
+{
+    const ScopedLock sl (prepareLock);
+
+    isPrepared = false;
+
+    for (auto* track : tracks)
+        track->transport.releaseResources();
+}
+
+void TrackSwitcher::getNextAudioBlock (const AudioSourceChannelInfo& bufferToFill)
+{
+    if (auto* incoming = pendingTrack.exchange (nullptr))
+        startNextTrack (incoming, activeTrack != nullptr
+                                    && activeTrack->transport.isPlaying()
+                                    && incoming->transport.isPlaying());
+
+    if (activeTrack == nullptr)
+    {
+        bufferToFill.clearActiveBufferRegion();
+        return;
+    }
+
+    if (scrubbing)
+    {
+        renderScrub (bufferToFill);
+        return;
+    }
+
+    // when the scrub lets go, playback carries on from wherever it left the playhead
+    if (scrubber.isActive())
+        activeTrack->bufferingSource->setNextReadPosition (scrubber.stop());
+
+    const auto seek = pendingSeek.exchange (-1.0);
+
+    if (seek >= 0.0)
+    {
+        usePlainPositions (*activeTrack);
+        activeTrack->transport.setPosition (seek);
+    }
+
+    const auto backwards = reverse.load();
+    setDirection (*activeTrack, backwards);
+
+    if (outgoingTrack != nullptr)
+        setDirection (*outgoingTrack, backwards);
+
+    auto& buffer = *bufferToFill.buffer;
+    auto* next = peekQueuedTrack();
+
+    for (int done = 0; done < bufferToFill.numSamples;)
+    {
+        auto num = bufferToFill.numSamples - done;
+        const auto untilTransition = getSamplesUntilTransition();
+        const auto switchesInThisBlock = next != nullptr && untilTransition < num;
+
+        if (switchesInThisBlock)
+            num = untilTransition;
+
+        if (num > 0)
+        {
+            const auto start = bufferToFill.startSample + done;
+
+            activeTrack->transport.getNextAudioBlock (AudioSourceChannelInfo (&buffer, start, num));
+
+            if (outgoingTrack != nullptr)
+                mixOutgoing (buffer, start, num);
+
+            done += num;
+        }
+
+        if (switchesInThisBlock)
+        {
+            queuedFifo.finishedRead (1);
+            lastStartedQueueId = next->queueId;
+
+            startNextTrack (next, true);
+
+            next->handoff = ++lastHandoff;
+            advancedTrack = next;
+            triggerAsyncUpdate();
+
+            next = peekQueuedTrack();
+        }
+    }
+
+    // the transport only notices the end of its source, so the start is caught here
+    if (backwards && activeTrack->transport.isPlaying()
+         && activeTrack->bufferingSource->getNextReadPosition() < 0
+         && ! reachedStart.exchange (true))
+        triggerAsyncUpdate();
+
+    publishPosition();
+}
+
+void TrackSwitcher::renderScrub (const AudioSourceChannelInfo& bufferToFill)
+{
+    auto& track = *activeTrack;
+    const auto fileRate = track.reader->sampleRate;
+
+    // a scrub moves around the plain file, so it starts from the file position
+    if (! scrubber.isActive())
+    {
+        const auto filePosition = track.readerSource->getFilePosition (jmax ((int64) 0, track.bufferingSource->getNextReadPosition()));
+
+        usePlainPositions (track);
+        scrubber.start (filePosition);
+    }
+
+    if (outgoingTrack != nullptr)
+    {
+        retire (outgoingTrack);
+        outgoingTrack = nullptr;
+    }
+
+    const auto target = jmin (scrubTarget.load() * fileRate, (double) track.reader->lengthInSamples);
+
+    scrubber.render (*track.bufferingSource, fileRate, target,
+                     *bufferToFill.buffer, bufferToFill.startSample, bufferToFill.numSamples);
+
+    publishPosition();
+}
+
+//==============================================================================
+void TrackSwitcher::startNextTrack (Track* next, bool crossfade) noexcept
+{
+    // a fade that is still running gets cut short by the newer track
+    if (outgoingTrack != nullptr)
+        retire (outgoingTrack);
+
+    outgoingTrack = nullptr;
+
+    fadeLength = roundToInt (crossfadeSeconds.load() * sampleRate);
+    fadePosition = 0;
+
+    if (activeTrack != nullptr)
+    {
+        if (crossfade && fadeLength > 0)
+            outgoingTrack = activeTrack;
+        else
+            retire (activeTrack);
+    }
+
+    // a scrub in progress picks up again from the new track's playhead
+    if (scrubber.isActive())
+        scrubber.stop();
+
+    activeTrack = next;
+    setDirection (*activeTrack, reverse);
+    activeTrack->state = Track::playing;
+}
+
+int TrackSwitcher::getSamplesUntilTransition() const noexcept
+{
+    constexpr auto never = std::numeric_limits<int>::max();
+
+    if (outgoingTrack != nullptr || looping || reverse || ! activeTrack->transport.isPlaying())
+        return never;
+
+    // with a crossfade, the next track starts early enough for the fade to end
+    // exactly on the last sample of the current one
+    const auto remaining = activeTrack->transport.getTotalLength() - activeTrack->transport.getNextReadPosition();
+    const auto fade = (int64) roundToInt (crossfadeSeconds.load() * sampleRate);
+
+    return (int) jlimit ((int64) 0, (int64) never, remaining - fade);
+}
+
+TrackSwitcher::Track* TrackSwitcher::peekQueuedTrack() noexcept
+{
+    for (;;)
+    {
+        int start1, size1, start2, size2;
+        queuedFifo.prepareToRead (1, start1, size1, start2, size2);
+
+        if (size1 == 0)
+            return nullptr;
+
+        auto* track = queuedTracks[(size_t) start1];
+
+        if (track->queueId >= firstValidQueueId.load())
+            return track;
+
+        // left over from a queue that has since been replaced
+        queuedFifo.finishedRead (1);
+        retire (track);
+    }
+}
+
+void TrackSwitcher::mixOutgoing (AudioBuffer<float>& buffer, int startSample, int numSamples)
+{
+    const auto numChannels = jmin (buffer.getNumChannels(), fadeBuffer.getNumChannels());
+
+    for (int done = 0; done < numSamples && outgoingTrack != nullptr;)
+    {
+        const auto num = jmin (numSamples - done, fadeBuffer.getNumSamples());
+        const auto start = startSample + done;
+
+        outgoingTrack->transport.getNextAudioBlock (AudioSourceChannelInfo (&fadeBuffer, 0, num));
+
+        for (int i = 0; i < num; ++i)
+        {
+            // equal-power: the two gains always satisfy in^2 + out^2 == 1
+            const auto t = jmin (1.0f, (float) (fadePosition + i) / (float) fadeLength);
+            const auto gainIn  = std::sin (t * MathConstants<float>::halfPi);
+            const auto gainOut = std::cos (t * MathConstants<float>::halfPi);
+
+            for (int ch = 0; ch < numChannels; ++ch)
+            {
+                auto* dest = buffer.getWritePointer (ch, start);
+                dest[i] = dest[i] * gainIn + fadeBuffer.getSample (ch, i) * gainOut;
+            }
+        }
+
+        done += num;
+        fadePosition += num;
+
+        if (fadePosition >= fadeLength)
+        {
+            retire (outgoingTrack);
+            outgoingTrack = nullptr;
+        }
+    }
+}
+
+void TrackSwitcher::publishPosition() noexcept
+{
+    const auto& track = *activeTrack;
+    const auto readPosition = jmax ((int64) 0, track.bufferingSource->getNextReadPosition());
+    const auto fileRate = track.reader->sampleRate;
+
+    // positions that were read before a loop change still map the way they were read
+    playPosition = (double) track.readerSource->getFilePosition (readPosition) / fileRate;
+    playLength = (double) track.reader->lengthInSamples / fileRate;
+
+    // what's heard right now was read a little earlier, or later when going backwards
+    const auto latency = (int64) (outputLatency.load() * fileRate);
+    const auto heard = reverse ? jmin (readPosition + latency, track.reader->lengthInSamples)
+                               : jmax ((int64) 0, readPosition - latency);
+
+    audiblePosition = (double) track.readerSource->getFilePosition (heard) / fileRate;
+}
+
+void TrackSwitcher::usePlainPositions (Track& track) noexcept
+{
+    // Seeks and the scrub are in the file's own samples. Once a loop change has moved the
+    // stream away from those, it's put back onto them, and what was read the other way
+    // is read again.
+    if (track.readerSource->resetMapping())
+        track.bufferingSource->discardBuffered();
+}
+
+void TrackSwitcher::setDirection (Track& track, bool backwards) noexcept
+{
+    auto& source = *track.bufferingSource;
+
+    // The loop only applies going forwards, so before turning around the playhead moves off
+    // the unrolled stream onto the place in the file it had got to. Otherwise it would go
+    // back through every pass of the loop before reaching what came before it.
+    if (backwards && ! source.isReverse())
+    {
+        const auto position = jmax ((int64) 0, source.getNextReadPosition());
+        const auto filePosition = track.readerSource->getFilePosition (position);
+
+        usePlainPositions (track);
+
+        if (filePosition != position)
+            source.setNextReadPosition (filePosition);
+    }
+
+    source.setReverse (backwards);
+}
+
+void TrackSwitcher::retire (Track* track) noexcept
+{
+    track->state = Track::retired;
+}
+
+//==============================================================================
+void TrackSwitcher::run()
+{
+    RealtimeSetup::applyToCurrentThread (RealtimeSetup::diskThreads);
+
+    while (! threadShouldExit())
+    {
+        releaseRetiredTracks();
+
+        std::unique_ptr<LoadRequest> request;
+
+        {
+            const ScopedLock sl (requestLock);
+            std::swap (request, pendingRequest);
+        }
+
+        if (request != nullptr)
+        {
+            load (*request);
+            continue;
+        }
+
+        preloadQueue();
+        wait (20);
+    }
+}
+
+void TrackSwitcher::load (LoadRequest& request)
+{
+    auto* track = waitForIdleTrack();
+
+    if (track == nullptr)
+    {
+        if (! threadShouldExit())
+            finishLoad (request, nullptr);
+
+        return;
+    }
+
+    track->state = Track::loading;
+
+    if (! openTrack (*track, request.url))
+    {
+        track->state = Track::idle;
+        finishLoad (request, nullptr);
+        return;
+    }
+
+    track->queueId = -1;
+
+    if (request.startPlaying)
+        track->transport.start();
+
+    track->state = Track::ready;
+    finishLoad (request, track);
+}
+
+void TrackSwitcher::finishLoad (LoadRequest& request, Track* track)
+{
+    const ScopedLock sl (requestLock);
+    const auto sequence = ++lastHandoff;
+
+    if (track != nullptr)
+    {
+        track->handoff = sequence;
+
+        // if the audio thread hasn't picked up an earlier track yet, that one is dropped
+        if (auto* superseded = pendingTrack.exchange (track))
+            retire (superseded);
+    }
+
+    finishedLoads.push_back (Handoff { sequence, track, std::move (request.onLoaded) });
+    triggerAsyncUpdate();
+}
+
+void TrackSwitcher::preloadQueue()
+{
+    while (! threadShouldExit())
+    {
+        QueueEntry entry;
+
+        {
+            const ScopedLock sl (requestLock);
+
+            // forget about the entries that the audio thread has already started
+            const auto lastStarted = lastStartedQueueId.load();
+
+            while (! queue.isEmpty() && queue.getReference (0).id <= lastStarted)
+                queue.remove (0);
+
+            auto index = 0;
+
+            while (index < queue.size() && queue.getReference (index).id <= lastPreloadedId)
+                ++index;
+
+            if (index >= numToPreload || index >= queue.size())
+                return;
+
+            entry = queue[index];
+        }
+
+        auto* track = findIdleTrack();
+
+        if (track == nullptr)
+            return;
+
+        track->state = Track::loading;
+
+        const auto opened = openTrack (*track, entry.url);
+
+        {
+            const ScopedLock sl (requestLock);
+
+            if (entry.id < firstValidQueueId.load())
+            {
+                // the queue was replaced while this one was loading
+                track->state = opened ? Track::retired : Track::idle;
+                continue;
+            }
+
+            lastPreloadedId = entry.id;
+
+            if (! opened)
+            {
+                queue.removeIf ([&] (const QueueEntry& e) { return e.id == entry.id; });
+                track->state = Track::idle;
+                continue;
+            }
+        }
+
+        // queued transports are already started, they begin moving as soon as the
+        // audio thread starts pulling from them
+        track->queueId = entry.id;
+        track->transport.start();
+        track->state = Track::queued;
+
+        int start1, size1, start2, size2;
+        queuedFifo.prepareToWrite (1, start1, size1, start2, size2);
+        jassert (size1 == 1);
+
+        queuedTracks[(size_t) start1] = track;
+        queuedFifo.finishedWrite (1);
+    }
+}
+
+bool TrackSwitcher::openTrack (Track& track, const URL& url)
+{
+    auto reader = [&]() -> std::unique_ptr<AudioFormatReader>
+    {
+        auto source = makeInputSource (url);
+
+        if (source == nullptr)
+            return {};
+
+        auto stream = rawToUniquePtr (source->createInputStream());
+
+        if (stream == nullptr)
+            return {};
+
+        return rawToUniquePtr (formatManager.createReaderFor (std::move (stream)));
+    }();
+
+    if (reader == nullptr)
+        return false;
+
+    const ScopedLock sl (prepareLock);
+
+    track.url = url;
+    track.reader = std::move (reader);
+    track.readerSource.reset (new LoopingReaderSource (*track.reader));
+    track.readerSource->setLooping (looping);
+
+    // the read-ahead buffer is filled when it gets prepared, so by the time the track
+    // is handed to the audio thread the audio around its start is already decoded
+    // every channel of the file is kept, mono ones are read onto both sides
+    const auto numChannels = jlimit (2, maxNumChannels, (int) track.reader->numChannels);
+
+    track.bufferingSource.reset (new BidirectionalBufferingSource (track.readerSource.get(), readAheadThread,
+                                                                   roundToInt (2.0 * sampleRate), numChannels));
+
+    // a new loop takes over a little way past the playhead, so it's heard straight away
+    // without touching what's about to be played
+    track.bufferingSource->remapSource = [source = track.readerSource.get()] (int64 position)
+    {
+        return source->applyPendingLoop (position);
+    };
+
+    track.transport.setSource (track.bufferingSource.get(), 0, nullptr, track.reader->sampleRate, numChannels);
+
+    if (isPrepared)
+        track.transport.prepareToPlay (blockSize, sampleRate);
+
+    return true;
+}
+
+void TrackSwitcher::releaseRetiredTracks()
+{
+    for (auto* track : tracks)
+    {
+        if (track->state != Track::retired)
+            continue;
+
+        {
+            const ScopedLock sl (prepareLock);
+
+            if (track->heldAsCurrent)
+                continue;
+
+            track->handoff = 0;
+            track->transport.stop();
+            track->transport.setSource (nullptr);
+            track->transport.releaseResources();
+            track->bufferingSource.reset();
+            track->readerSource.reset();
+            track->reader.reset();
+        }
+
+        track->state = Track::idle;
+    }
+}
+
+TrackSwitcher::Track* TrackSwitcher::findIdleTrack() const
+{
+    for (auto* track : tracks)
+        if (track->state == Track::idle)
+            return track;
+
+    return nullptr;
+}
+
+TrackSwitcher::Track* TrackSwitcher::waitForIdleTrack()
+{
+    auto* track = findIdleTrack();
+
+    // All tracks are busy, which only happens while a fade is running and the preload
+    // queue is full, so wait for one of them to be retired. Only the audio thread retires
+    // them though, and it may not be running at all, e.g. while the device is still being
+    // opened, so after a while the request fails instead.
+    constexpr uint32 timeoutMs = 1000;
+    const auto startTime = Time::getMillisecondCounter();
+
+    while (track == nullptr)
+    {
+        if (threadShouldExit() || Time::getMillisecondCounter() - startTime > timeoutMs)
+            return nullptr;
+
+        wait (5);
+        releaseRetiredTracks();
+        track = findIdleTrack();
+    }
+
+    return track;
+}
+
+//==============================================================================
+void TrackSwitcher::handleAsyncUpdate()
+{
+    if (reachedStart.exchange (false) && currentTrack != nullptr)
+        currentTrack->transport.stop();
+
+    std::vector<Handoff> handoffs;
+
+    {
+        const ScopedLock sl (requestLock);
+        std::swap (handoffs, finishedLoads);
+    }
+
+    // Only the latest track the queue moved on to matters, and it goes in among the loads
+    // by its sequence number. A track that has been recycled since reads as 0, and one that
+    // was loaded again already has a handoff of its own.
+    if (auto* advanced = advancedTrack.exchange (nullptr))
+    {
+        const auto sequence = advanced->handoff.load();
+        auto position = std::find_if (handoffs.begin(), handoffs.end(),
+                                      [sequence] (const Handoff& h) { return h.sequence >= sequence; });
+
+        if (sequence > 0 && (position == handoffs.end() || position->sequence != sequence))
+            handoffs.insert (position, Handoff { sequence, advanced, nullptr, true });
+    }
+
+    for (auto& handoff : handoffs)
+    {
+        if (handoff.track != nullptr && makeCurrent (*handoff.track, handoff.sequence)
+             && handoff.advanced && onTrackChanged != nullptr)
+            onTrackChanged();
+
+        if (handoff.onLoaded != nullptr)
+            handoff.onLoaded (handoff.track != nullptr);
+    }
+}
+
+bool TrackSwitcher::makeCurrent (Track& track, uint64 sequence)
+{
+    const ScopedLock sl (prepareLock);
+
+    // An older handoff that arrived late, or a track that has been recycled since it was
+    // handed over, is left alone: a later handoff has replaced it.
+    if (sequence < currentHandoff || track.handoff != sequence)
+        return false;
+
+    if (currentTrack != nullptr)
+        currentTrack->heldAsCurrent = false;
+
+    track.heldAsCurrent = true;
+    currentTrack = &track;
+    currentHandoff = sequence;
+
+    return true;
+}
@@ -0,0 +1,242 @@
+#pragma once
+
+#include "EngineModules.h"
+#include "LoopingReaderSource.h"
+#include "BidirectionalBufferingSource.h"
+#include "VarispeedScrubber.h"
+
+/** Plays one track at a time and switches between tracks without a gap.
+
+    A new track is opened and prepared on a background thread, then handed to the
+    audio thread, which swaps it in at the next block boundary, optionally with an
+    equal-power crossfade. Tracks that stopped playing are released on the same
+    background thread, so the audio thread never opens or closes a file.
+
+    Tracks can also be queued. The next few entries of the queue are opened and
+    their read-ahead buffers filled in advance; when the playing track reaches its
+    end the audio thread moves on to the next one at the exact sample, either
+    back-to-back or with the crossfade ending on the last sample of the old track.
+
+    Playback can also run backwards. The queue only moves on while playing forwards,
+    and a track that has been played back to its start stops there.
+*/
+class TrackSwitcher final : public AudioSource,
+                            private Thread,
+                            private AsyncUpdater
+{
+public:
+    TrackSwitcher (AudioFormatManager& formatManager, TimeSliceThread& readAheadThread,
+                   int numTracksToPreload = 2);
+    ~TrackSwitcher() override;
+
+    /** The most channels a file or the output can have. Anything past this is dropped. */
+    static constexpr int maxNumChannels = 8;
+
+    //==============================================================================
+    /** Opens the URL in the background and switches to it once it is ready.
+        onLoaded is called on the message thread with the result.
+    */
+    void loadAsync (const URL& url, bool startPlaying, std::function<void (bool)> onLoaded);
+
+    /** Replaces the list of tracks that follow the current one. */
+    void setQueue (const Array<URL>& urls);
+
+    /** Returns the tracks that haven't started playing yet. Message thread only. */
+    Array<URL> getQueue() const;
+
+    /** Sets the length of the crossfade between two tracks, 0 makes the switch gapless. */
+    void setCrossfadeLength (double seconds) noexcept;
+
+    void setLooping (bool shouldLoop);
+
+    /** Sets the part of the current track that is repeated while looping is on.
+        An empty range loops the whole file.
+    */
+    void setLoopRegion (Range<double> regionInSeconds);
+
+    /** Plays the tracks backwards when true. The loop region only applies going forwards. */
+    void setReverse (bool shouldPlayBackwards) noexcept     { reverse = shouldPlayBackwards; }
+    bool isReverse() const noexcept                         { return reverse; }
+
+    /** Returns the playing track's position in its file, in seconds. This is published by
+        the audio thread once per block, so it's safe to call from any thread.
+    */
+    double getCurrentPosition() const noexcept      { return playPosition; }
+    double getLengthInSeconds() const noexcept      { return playLength; }
+
+    /** Sets how long the processing after this source takes to reach the output, in
+        seconds of the track. Any thread.
+    */
+    void setOutputLatency (double seconds) noexcept     { outputLatency = jmax (0.0, seconds); }
+
+    /** Returns the position that can be heard right now. It trails getCurrentPosition()
+        by the output latency, and is what a playhead on screen should show.
+    */
+    double getAudiblePosition() const noexcept      { return audiblePosition; }
+
+    /** Moves the playing track to a position in its file. The seek itself is done on the
+        audio thread at the start of the next block, so no lock is needed.
+    */
+    void setPosition (double seconds) noexcept;
+
+    /** Scrubs the playing track like a tape pulled by hand: while a scrub is on, the playhead
+        chases the last position passed to scrubTo() with a smoothed rate, whether or not the
+        transport is running. These only set atomics, so they're safe from any thread.
+    */
+    void beginScrub() noexcept;
+    void scrubTo (double seconds) noexcept      { scrubTarget = jmax (0.0, seconds); }
+    void endScrub() noexcept                    { scrubbing = false; }
+
+    /** Returns the transport of the track that is currently playing, or nullptr.
+        Only call this from the message thread.
+    */
+    AudioTransportSource* getCurrentTransport() const noexcept;
+
+    /** Returns the URL of the track that is currently playing. Message thread only. */
+    URL getCurrentURL() const;
+
+    /** Registers a listener with the transport of every track. */
+    void addTransportListener (ChangeListener* listener);
+    void removeTransportListener (ChangeListener* listener);
+
+    /** Called on the message thread when playback has moved on to the next queued track. */
+    std::function<void()> onTrackChanged;
+
+    //==============================================================================
+    void prepareToPlay (int samplesPerBlockExpected, double sampleRate) override;
+    void releaseResources() override;
+    void getNextAudioBlock (const AudioSourceChannelInfo& bufferToFill) override;
+
+private:
+    //==============================================================================
+    struct Track
+    {
+        enum State
+        {
+            idle,
+            loading,
+            ready,
+            queued,
+            playing,
+            retired
+        };
+
+        std::atomic<int> state { idle };
+
+        // the handoff this track was last made the playing one by, 0 once it's recycled
+        std::atomic<uint64> handoff { 0 };
+
+        // set while the message thread uses it as its current track, which keeps the
+        // loader from recycling it even after the audio thread has retired it
+        std::atomic<bool> heldAsCurrent { false };
+
+        URL url;
+        int64 queueId = -1;
+
+        std::unique_ptr<AudioFormatReader> reader;
+        std::unique_ptr<LoopingReaderSource> readerSource;
+        std::unique_ptr<BidirectionalBufferingSource> bufferingSource;
+        AudioTransportSource transport;
+    };
+
+    struct LoadRequest
+    {
+        URL url;
+        bool startPlaying = false;
+        std::function<void (bool)> onLoaded;
+    };
+
+    /** A track becoming the playing one, or a load that failed. The message thread
+        applies these in the order of their sequence numbers, whichever thread they came from.
+    */
+    struct Handoff
+    {
+        uint64 sequence = 0;
+        Track* track = nullptr;
+        std::function<void (bool)> onLoaded;
+        bool advanced = false;
+    };
+
+    struct QueueEntry
+    {
+        URL url;
+        int64 id = -1;
+    };
+
+    void run() override;
+    void handleAsyncUpdate() override;
+
+    void load (LoadRequest& request);
+    void finishLoad (LoadRequest& request, Track* track);
+    void preloadQueue();
+    bool openTrack (Track& track, const URL& url);
+    void releaseRetiredTracks();
+    Track* findIdleTrack() const;
+    Track* waitForIdleTrack();
+    bool makeCurrent (Track& track, uint64 sequence);
+
+    void retire (Track* track) noexcept;
+    Track* peekQueuedTrack() noexcept;
+    void startNextTrack (Track* next, bool crossfade) noexcept;
+    int getSamplesUntilTransition() const noexcept;
+    void mixOutgoing (AudioBuffer<float>& buffer, int startSample, int numSamples);
+    void renderScrub (const AudioSourceChannelInfo& bufferToFill);
+    void publishPosition() noexcept;
+    void usePlainPositions (Track& track) noexcept;
+    void setDirection (Track& track, bool backwards) noexcept;
+
+    //==============================================================================
+    AudioFormatManager& formatManager;
+    TimeSliceThread& readAheadThread;
+
+    const int numToPreload;
+    OwnedArray<Track> tracks;
+
+    // guards the track sources and the prepared state against the loader thread
+    CriticalSection prepareLock;
+    bool isPrepared = false;
+    int blockSize = 512;
+    double sampleRate = 44100.0;
+    std::atomic<bool> looping { false }, reverse { false };
+
+    // guarded by requestLock
+    CriticalSection requestLock;
+    std::unique_ptr<LoadRequest> pendingRequest;
+    std::vector<Handoff> finishedLoads;
+    Array<QueueEntry> queue;
+    int64 nextQueueId = 0, lastPreloadedId = -1;
+
+    // preloaded tracks, in queue order, from the loader to the audio thread
+    AbstractFifo queuedFifo;
+    std::vector<Track*> queuedTracks;
+    std::atomic<int64> firstValidQueueId { 0 }, lastStartedQueueId { -1 };
+
+    // handed from the loader to the audio thread
+    std::atomic<Track*> pendingTrack { nullptr };
+    std::atomic<Track*> advancedTrack { nullptr };
+    std::atomic<uint64> lastHandoff { 0 };
+
+    // audio thread only
+    Track* activeTrack = nullptr;
+    Track* outgoingTrack = nullptr;
+    AudioBuffer<float> fadeBuffer;
+    int fadePosition = 0, fadeLength = 0;
+    std::atomic<double> crossfadeSeconds { 0.25 };
+
+    // published by the audio thread, in seconds
+    std::atomic<double> playPosition { 0.0 }, playLength { 0.0 };
+    std::atomic<double> audiblePosition { 0.0 }, outputLatency { 0.0 };
+    std::atomic<double> pendingSeek { -1.0 };
+    std::atomic<bool> reachedStart { false };
+
+    // set from the message thread, the scrubber itself belongs to the audio thread
+    std::atomic<bool> scrubbing { false };
+    std::atomic<double> scrubTarget { 0.0 };
+    VarispeedScrubber scrubber;
+
+    // message thread only
+    Track* currentTrack = nullptr;
+    uint64 currentHandoff = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (TrackSwitcher)
+};
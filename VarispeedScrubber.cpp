@@ -0,0 +1,105 @@
+#include "VarispeedScrubber.h"
+
+void VarispeedScrubber::prepare (double sampleRate, int maximumBlockSize, int numChannels)
+{
+    outputRate = sampleRate;
+
+    // enough for a block at full speed from a source at up to four times the output rate
+    scratch.setSize (numChannels, roundToInt (maxSpeed * 4.0 * maximumBlockSize) + 2 * margin, false, false, true);
+
+    const auto pathLength = (size_t) jmax (1, maximumBlockSize);
+    indices.resize (pathLength);
+    fractions.resize (pathLength);
+    gains.resize (pathLength);
+}
+
+void VarispeedScrubber::start (int64 sourcePosition) noexcept
+{
+    active = true;
+    position = (double) sourcePosition;
+    rate = 0.0;
+    gain = 0.0f;
+}
+
+int64 VarispeedScrubber::stop() noexcept
+{
+    active = false;
+    return jmax ((int64) 0, (int64) position);
+}
+
+void VarispeedScrubber::render (BidirectionalBufferingSource& source, double sourceSampleRate, double targetPosition,
+                                AudioBuffer<float>& dest, int startSample, int numSamples) noexcept
+{
+    if (numSamples <= 0 || gains.empty())
+        return;
+
+    // rates are in source samples per output sample, normal speed is the ratio of the two rates
+    const auto nominal = sourceSampleRate / outputRate;
+    const auto maxRate = jmin (maxSpeed * nominal, (double) (scratch.getNumSamples() - 2 * margin) / numSamples);
+
+    // chasing the target at a rate proportional to the distance makes a steady drag play
+    // at the speed of the drag, smoothing the rate turns the mouse's steps into a glide
+    const auto desired = jlimit (-maxRate, maxRate, (targetPosition - position) / (responseSeconds * outputRate));
+    const auto coeff = 1.0 - std::exp (-numSamples / (smoothingSeconds * outputRate));
+    const auto newRate = rate + (desired - rate) * coeff;
+    const auto rateStep = (newRate - rate) / numSamples;
+
+    // the rate ramps linearly over the block, so the playhead only turns around where it crosses zero
+    const auto endPosition = position + numSamples * (rate + newRate) * 0.5;
+    auto lowest = jmin (position, endPosition);
+    auto highest = jmax (position, endPosition);
+
+    if (rate * newRate < 0.0)
+    {
+        const auto turn = position + (rate / (rate - newRate)) * numSamples * rate * 0.5;
+        lowest = jmin (lowest, turn);
+        highest = jmax (highest, turn);
+    }
+
+    const auto first = (int64) std::floor (lowest) - margin;
+    const auto numToRead = jmin (scratch.getNumSamples(), (int) ((int64) std::ceil (highest) + margin - first));
+
+    source.readBuffered (scratch, 0, numToRead, first);
+
+    const auto newGain = (float) jlimit (0.0, 1.0, std::abs (newRate) / nominal * 4.0);
+    const auto gainStep = (newGain - gain) / (float) numSamples;
+    const auto numChannels = jmin (dest.getNumChannels(), scratch.getNumChannels());
+
+    auto r = rate;
+    auto g = gain;
+
+    // the playhead's path is the same for every channel, so it's worked out once for each
+    // stretch of the block and then every channel is interpolated along it
+    for (int done = 0; done < numSamples;)
+    {
+        const auto num = jmin (numSamples - done, (int) fractions.size());
+
+        for (int i = 0; i < num; ++i)
+        {
+            const auto offset = position - (double) first;
+            indices[(size_t) i] = jlimit (1, numToRead - 3, (int) offset);
+            fractions[(size_t) i] = (float) jlimit (0.0, 1.0, offset - indices[(size_t) i]);
+            gains[(size_t) i] = g;
+
+            position += r;
+            r += rateStep;
+            g += gainStep;
+        }
+
+        for (int ch = 0; ch < numChannels; ++ch)
+            kernels.hermite (dest.getWritePointer (ch, startSample + done), scratch.getReadPointer (ch),
+                             indices.data(), fractions.data(), gains.data(), num);
+
+        done += num;
+    }
+
+    for (int ch = numChannels; ch < dest.getNumChannels(); ++ch)
+        dest.clear (ch, startSample, numSamples);
+
+    rate = newRate;
+    gain = newGain;
+    position = jlimit (0.0, (double) source.getTotalLength(), position);
+
+    // the read-ahead buffer follows the playhead and leans the way it's travelling
+    source.movePlayhead ((int64) position, rate < 0.0);
+}
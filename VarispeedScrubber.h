@@ -0,0 +1,57 @@
+#pragma once
+
+#include "EngineModules.h"
+#include "BidirectionalBufferingSource.h"
+#include "SimdKernels.h"
+
+/** Tape-style scrubbing on top of a BidirectionalBufferingSource.
+
+    The playhead chases a target position, usually the mouse, at a rate proportional
+    to how far behind it is. That rate is smoothed from block to block, so a steady
+    drag plays at the speed of the drag and stopping the mouse winds the audio down
+    instead of cutting it. Samples are taken from the read-ahead buffer at the
+    fractional playhead with a 4-point Hermite interpolator, in either direction,
+    and the output gain follows the speed so that a near-stationary playhead is quiet.
+
+    Everything except prepare() is called on the audio thread.
+*/
+class VarispeedScrubber final
+{
+public:
+    VarispeedScrubber() = default;
+
+    void prepare (double sampleRate, int maximumBlockSize, int numChannels);
+
+    /** Starts scrubbing from a position in the source, in samples. */
+    void start (int64 sourcePosition) noexcept;
+
+    /** Stops scrubbing and returns the position the playhead has ended up at. */
+    int64 stop() noexcept;
+
+    bool isActive() const noexcept      { return active; }
+
+    /** Moves the playhead towards targetPosition, in source samples, and renders what it passes over. */
+    void render (BidirectionalBufferingSource& source, double sourceSampleRate, double targetPosition,
+                 AudioBuffer<float>& dest, int startSample, int numSamples) noexcept;
+
+private:
+    static constexpr double responseSeconds = 0.08;
+    static constexpr double smoothingSeconds = 0.03;
+    static constexpr double maxSpeed = 4.0;
+    static constexpr int margin = 4;
+
+    const SimdKernels& kernels = getSimdKernels();
+
+    double outputRate = 44100.0;
+    AudioBuffer<float> scratch;
+
+    // the playhead's path through the scratch buffer over part of a block
+    std::vector<int> indices;
+    std::vector<float> fractions, gains;
+
+    bool active = false;
+    double position = 0.0, rate = 0.0;
+    float gain = 0.0f;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (VarispeedScrubber)
+};